@@ -1,33 +0,0 @@
-/*
- * <one line to give the program's name and a brief idea of what it does.>
- * Copyright (C) 2018  Daniel Darias Sánchez <dariasteam94@gmail.com>
- *
- * This program is free software: you can redistribute it and/or modify
- * it under the terms of the GNU General Public License as published by
- * the Free Software Foundation, either version 3 of the License, or
- * (at your option) any later version.
- *
- * This program is distributed in the hope that it will be useful,
- * but WITHOUT ANY WARRANTY; without even the implied warranty of
- * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
- * GNU General Public License for more details.
- *
- * You should have received a copy of the GNU General Public License
- * along with this program.  If not, see <http://www.gnu.org/licenses/>.
- */
-
-#ifndef AXON_H
-#define AXON_H
-
-class axon {
-private:
-  double value;
-  double weight;
-public:
-  axon (double w) : weight (w) {}
-  void set_value (double v) { value = v; }
-  double get_value () const { return value * weight; }
-};
-
-
-#endif // AXON_H
@@ -0,0 +1,378 @@
+/*
+ * <one line to give the program's name and a brief idea of what it does.>
+ * Copyright (C) 2018  Daniel Darias Sánchez <dariasteam94@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "concurrent_neural_network.h"
+#include "perf_counters.h"
+#include "random_nets.h"
+
+/**
+ * Benchmark of the construction and evaluation of random nets over a grid of
+ * sizes, densities and feedback ratios:
+ *
+ *   concurrent_bench [--sizes 50,200,1000] [--densities 0.02,0.067]
+ *                    [--feedback 0,0.5] [--threads 1,2,4] [--batches 1,16,256]
+ *                    [--modes steps,dataflow,incremental] [--warmup N] [--repetitions N]
+ *                    [--seed N] [--format csv|json] [--output file]
+ *                    [--input dense|sparse] [--order input,locality]
+ *
+ * With --input sparse the nets are generated and built from an edge list
+ * with the same expected fan-in (density times size), which allows sizes
+ * whose dense matrices would not fit in memory. --order locality evaluates
+ * the nets after #concurrent_neural_network::reorder_neurons. The single
+ * evaluations also report the L1 data and last level cache misses of the
+ * calling thread when the hardware counters are available.
+ *
+ * Every measurement is one record (configuration, metric, value, unit), so
+ * results of different builds can be joined by configuration and compared.
+ */
+
+struct bench_options {
+  std::vector<unsigned> sizes {50, 200, 1000};
+  std::vector<double> densities {1.0 / 15};
+  std::vector<double> feedback {0.5};
+  std::vector<unsigned> threads;
+  std::vector<unsigned> batches {1, 16, 256};
+  std::vector<execution_mode> modes {execution_mode::steps};
+  unsigned warmup = 100;
+  unsigned repetitions = 1000;
+  unsigned seed = 1;
+  std::string format = "csv";
+  std::string output;
+  bool sparse = false;
+  std::vector<bool> reorder {false};
+};
+
+struct bench_record {
+  unsigned size;
+  unsigned neurons;
+  unsigned edges;
+  double density;
+  double feedback;
+  std::string order;
+  std::string mode;
+  unsigned threads;
+  unsigned batch;
+  std::string metric;
+  double value;
+  std::string unit;
+};
+
+typedef std::chrono::steady_clock bench_clock;
+
+static double seconds_since (bench_clock::time_point begin) {
+  return std::chrono::duration<double>(bench_clock::now() - begin).count();
+}
+
+static double percentile (std::vector<double> values, double p) {
+  if (values.empty())
+    return 0;
+  std::sort(values.begin(), values.end());
+  unsigned k = std::min<unsigned>(values.size() - 1, p * values.size());
+  return values[k];
+}
+
+template <class T>
+static std::vector<T> parse_list (const std::string& text) {
+  std::vector<T> values;
+  std::stringstream stream (text);
+  std::string item;
+  while (std::getline(stream, item, ',')) {
+    std::stringstream value (item);
+    T v;
+    if (value >> v)
+      values.push_back(v);
+  }
+  return values;
+}
+
+static const char* mode_name (execution_mode mode) {
+  switch (mode) {
+    case execution_mode::dataflow: return "dataflow";
+    case execution_mode::incremental: return "incremental";
+    default: return "steps";
+  }
+}
+
+static bool parse_options (int argc, char **argv, bench_options& options) {
+  for (int k = 1; k < argc; k++) {
+    std::string option = argv[k];
+    if (k + 1 >= argc)
+      return false;
+    std::string value = argv[++k];
+
+    if (option == "--sizes")
+      options.sizes = parse_list<unsigned>(value);
+    else if (option == "--densities")
+      options.densities = parse_list<double>(value);
+    else if (option == "--feedback")
+      options.feedback = parse_list<double>(value);
+    else if (option == "--threads") {
+      // the calling thread is one of them, there is no pool of -1 workers
+      options.threads = parse_list<unsigned>(value);
+      if (std::find(options.threads.begin(), options.threads.end(), 0u) != options.threads.end())
+        return false;
+    }
+    else if (option == "--batches")
+      options.batches = parse_list<unsigned>(value);
+    else if (option == "--warmup")
+      options.warmup = std::atoi(value.c_str());
+    else if (option == "--repetitions")
+      options.repetitions = std::max(1, std::atoi(value.c_str()));
+    else if (option == "--seed")
+      options.seed = std::atoi(value.c_str());
+    else if (option == "--format")
+      options.format = value;
+    else if (option == "--output")
+      options.output = value;
+    else if (option == "--input" && (value == "dense" || value == "sparse"))
+      options.sparse = (value == "sparse");
+    else if (option == "--order") {
+      options.reorder.clear();
+      for (const std::string& name : parse_list<std::string>(value)) {
+        if (name != "input" && name != "locality")
+          return false;
+        options.reorder.push_back(name == "locality");
+      }
+    }
+    else if (option == "--modes") {
+      options.modes.clear();
+      for (const std::string& name : parse_list<std::string>(value)) {
+        if (name == "steps")
+          options.modes.push_back(execution_mode::steps);
+        else if (name == "dataflow")
+          options.modes.push_back(execution_mode::dataflow);
+        else if (name == "incremental")
+          options.modes.push_back(execution_mode::incremental);
+        else
+          return false;
+      }
+    } else {
+      return false;
+    }
+  }
+
+  if (options.threads.empty()) {
+    // powers of two up to the hardware threads
+    unsigned hardware = std::max(1u, std::thread::hardware_concurrency());
+    for (unsigned t = 1; t < hardware; t *= 2)
+      options.threads.push_back(t);
+    options.threads.push_back(hardware);
+  }
+  return (options.format == "csv" || options.format == "json") && !options.reorder.empty();
+}
+
+static void write_records (std::ostream& out, const std::vector<bench_record>& records,
+                           const std::string& format) {
+  if (format == "csv") {
+    out << "size,neurons,edges,density,feedback,order,mode,threads,batch,metric,value,unit\n";
+    for (const bench_record& r : records)
+      out << r.size << ',' << r.neurons << ',' << r.edges << ',' << r.density << ','
+          << r.feedback << ',' << r.order << ',' << r.mode << ',' << r.threads << ',' << r.batch << ','
+          << r.metric << ',' << r.value << ',' << r.unit << '\n';
+    return;
+  }
+
+  out << "[\n";
+  for (unsigned k = 0; k < records.size(); k++) {
+    const bench_record& r = records[k];
+    out << "  {\"size\": " << r.size << ", \"neurons\": " << r.neurons << ", \"edges\": " << r.edges
+        << ", \"density\": " << r.density << ", \"feedback\": " << r.feedback
+        << ", \"order\": \"" << r.order << "\", \"mode\": \"" << r.mode
+        << "\", \"threads\": " << r.threads << ", \"batch\": " << r.batch
+        << ", \"metric\": \"" << r.metric << "\", \"value\": " << r.value
+        << ", \"unit\": \"" << r.unit << "\"}" << (k + 1 < records.size() ? "," : "") << '\n';
+  }
+  out << "]\n";
+}
+
+int main(int argc, char **argv) {
+  bench_options options;
+  if (!parse_options(argc, argv, options)) {
+    std::cerr << "usage: " << argv[0] << " [--sizes list] [--densities list] [--feedback list]"
+              << " [--threads list] [--batches list] [--modes steps,dataflow,incremental]"
+              << " [--warmup N] [--repetitions N] [--seed N] [--format csv|json] [--output file]"
+              << " [--input dense|sparse] [--order input,locality]" << std::endl;
+    return 1;
+  }
+
+  const unsigned inputs = 3;
+  const unsigned outputs = 2;
+  std::vector<bench_record> records;
+
+  for (unsigned size : options.sizes) {
+    for (double density : options.densities) {
+      for (double feedback : options.feedback) {
+        std::srand(options.seed);
+        std::vector<std::vector<bool>> vec_graph;
+        std::vector<std::vector<double>> vec_costs;
+        std::vector<double> thresholds;
+        std::vector<network_edge> edges;
+        if (options.sparse) {
+          random_sparse_generator(size, density * size, feedback, thresholds, edges);
+        } else {
+          vec_graph = random_graph_generator(size, density, feedback);
+          vec_costs = random_costs_generator(size);
+        }
+        auto build = [&](thread_pool* pool) {
+          return options.sparse
+            ? concurrent_neural_network (edges, thresholds, inputs, outputs, pool)
+            : concurrent_neural_network (vec_graph, vec_costs, inputs, outputs, pool);
+        };
+
+        bench_record record {size, 0, 0, density, feedback, "input", "", 0, 1, "", 0, ""};
+
+        // CONSTRUCTION -------------------------------------------------------
+
+        std::vector<double> construction;
+        unsigned builds = std::max(1u, std::min(options.repetitions, 20u));
+        for (unsigned k = 0; k < builds; k++) {
+          auto begin = bench_clock::now();
+          concurrent_neural_network net = build(nullptr);
+          construction.push_back(seconds_since(begin));
+          record.neurons = net.compiled().n_neurons();
+          record.edges = net.compiled().n_edges();
+        }
+        record.mode = "build";
+        record.metric = "construction_p50";
+        record.value = percentile(construction, 0.5) * 1e3;
+        record.unit = "ms";
+        records.push_back(record);
+
+        if (std::count(options.reorder.begin(), options.reorder.end(), true)) {
+          std::vector<double> reordering;
+          for (unsigned k = 0; k < builds; k++) {
+            concurrent_neural_network net = build(nullptr);
+            auto begin = bench_clock::now();
+            net.reorder_neurons();
+            reordering.push_back(seconds_since(begin));
+          }
+          record.order = "locality";
+          record.metric = "reorder_p50";
+          record.value = percentile(reordering, 0.5) * 1e3;
+          records.push_back(record);
+        }
+
+        std::cerr << "size " << size << " density " << density << " feedback " << feedback
+                  << ": " << record.neurons << " neurons, " << record.edges << " edges" << std::endl;
+
+        // EVALUATION ---------------------------------------------------------
+
+        std::vector<double> inputs_values (inputs, 0.5);
+        std::vector<double> outputs_values;
+
+        perf_counters counters;
+        for (bool reorder : options.reorder) {
+          for (execution_mode mode : options.modes) {
+            for (unsigned threads : options.threads) {
+              // the caller also calculates, so the pool has one worker less
+              thread_pool pool (threads - 1);
+              concurrent_neural_network net = build(&pool);
+              if (reorder)
+                net.reorder_neurons();
+              net.set_execution_mode(mode);
+              record.order = reorder ? "locality" : "input";
+              record.mode = mode_name(mode);
+              record.threads = threads;
+
+              // single evaluation latency
+              for (unsigned k = 0; k < options.warmup; k++)
+                net(inputs_values, outputs_values);
+              std::vector<double> latencies (options.repetitions);
+              perf_sample before, after;
+              counters.read(before);
+              for (unsigned k = 0; k < options.repetitions; k++) {
+                inputs_values[k % inputs] = (k % 7) / 7.0;
+                auto begin = bench_clock::now();
+                net(inputs_values, outputs_values);
+                latencies[k] = seconds_since(begin) * 1e6;
+              }
+              counters.read(after);
+              perf_sample misses = perf_difference(after, before);
+
+              record.batch = 1;
+              record.unit = "us";
+              record.metric = "latency_p50";
+              record.value = percentile(latencies, 0.5);
+              records.push_back(record);
+              record.metric = "latency_p99";
+              record.value = percentile(latencies, 0.99);
+              records.push_back(record);
+
+              record.unit = "misses/evaluation";
+              if (counters.available(PERF_L1D_MISSES)) {
+                record.metric = "l1d_misses";
+                record.value = double(misses.counts[PERF_L1D_MISSES]) / options.repetitions;
+                records.push_back(record);
+              }
+              if (counters.available(PERF_LLC_MISSES)) {
+                record.metric = "llc_misses";
+                record.value = double(misses.counts[PERF_LLC_MISSES]) / options.repetitions;
+                records.push_back(record);
+              }
+
+              // batched throughput
+              for (unsigned batch : options.batches) {
+                std::vector<std::vector<double>> inputs_batch (batch, inputs_values);
+                std::vector<std::vector<double>> outputs_batch;
+                for (unsigned b = 0; b < batch; b++)
+                  inputs_batch[b][b % inputs] = double(b) / batch;
+
+                unsigned rounds = std::max(1u, options.repetitions / batch);
+                for (unsigned k = 0; k < std::max(1u, options.warmup / batch); k++)
+                  net(inputs_batch, outputs_batch);
+                auto begin = bench_clock::now();
+                for (unsigned k = 0; k < rounds; k++)
+                  net(inputs_batch, outputs_batch);
+                double elapsed = seconds_since(begin);
+
+                record.batch = batch;
+                record.metric = "throughput";
+                record.value = (elapsed > 0) ? rounds * batch / elapsed : 0;
+                record.unit = "samples/s";
+                records.push_back(record);
+              }
+            }
+          }
+        }
+      }
+    }
+  }
+
+  if (options.output.empty()) {
+    write_records(std::cout, records, options.format);
+  } else {
+    std::ofstream file (options.output);
+    if (!file) {
+      std::cerr << "can not write " << options.output << std::endl;
+      return 1;
+    }
+    write_records(file, records, options.format);
+  }
+  return 0;
+}
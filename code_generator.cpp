@@ -0,0 +1,183 @@
+/*
+ * <one line to give the program's name and a brief idea of what it does.>
+ * Copyright (C) 2018  Daniel Darias Sánchez <dariasteam94@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <cctype>
+#include <cmath>
+#include <cstdio>
+#include <fstream>
+#include <vector>
+
+#include "code_generator.h"
+
+/**
+ * @brief Decimal with 17 significant digits, which reads back as exactly the
+ * same double. value must be finite.
+ */
+static std::string literal (double value) {
+  char buffer[32];
+  std::snprintf(buffer, sizeof(buffer), "%.17g", value);
+  std::string text (buffer);
+  if (text.find_first_of(".e") == std::string::npos)
+    text += ".0";
+  return text;
+}
+
+static void write_array (std::ostream& out, const char* name, const double* values, unsigned n) {
+  if (n == 0)
+    return;
+  out << "constexpr double " << name << "[" << n << "] = {";
+  for (unsigned k = 0; k < n; k++) {
+    out << ((k % 4 == 0) ? "\n  " : " ") << literal(values[k]);
+    if (k + 1 < n)
+      out << ",";
+  }
+  out << "\n};\n\n";
+}
+
+static bool finite_values (const double* values, unsigned n) {
+  for (unsigned k = 0; k < n; k++)
+    if (!std::isfinite(values[k]))
+      return false;
+  return true;
+}
+
+static bool valid_identifier (const std::string& name) {
+  if (name.empty() || std::isdigit(static_cast<unsigned char>(name[0])))
+    return false;
+  for (char c : name)
+    if (!std::isalnum(static_cast<unsigned char>(c)) && c != '_')
+      return false;
+  return true;
+}
+
+bool generate_network_source(const compiled_network& net, const std::string& name, std::ostream& out) {
+  if (!valid_identifier(name))
+    return false;
+
+  unsigned size = net.n_neurons();
+  unsigned inputs = net.n_inputs();
+  unsigned outputs = net.n_outputs();
+  unsigned registers = net.n_feedback_registers();
+  const unsigned* offsets = net.predecessor_offsets();
+  const unsigned* sources = net.predecessors();
+  const unsigned* feedback_offsets = net.feedback_predecessor_offsets();
+  const unsigned* feedback_sources = net.feedback_predecessors();
+  const unsigned* origins = net.feedback_register_origins();
+  const double* fan_in = net.neuron_fan_in();
+
+  // inf and nan have no literal, the source would not compile
+  if (!finite_values(net.forward_weights(), net.n_forward_edges()) ||
+      !finite_values(net.feedback_connection_weights(), net.n_feedback_edges()) ||
+      !finite_values(net.neuron_thresholds(), size) || !finite_values(fan_in, size))
+    return false;
+
+  // slot of the state that holds each feedback origin
+  std::vector<unsigned> slots (size);
+  for (unsigned r = 0; r < registers; r++)
+    slots[origins[r]] = r;
+
+  // HEADER -----------------------------------------------------------------
+
+  out << "// Evaluation of a fixed net, generated by generate_network_source.\n"
+      << "// " << size << " neurons, " << inputs << " inputs, " << outputs << " outputs, "
+      << net.n_forward_edges() << " forward and " << net.n_feedback_edges()
+      << " feedback connections.\n"
+      << "// Build it with -ffp-contract=off and without -ffast-math to get the\n"
+      << "// same results as the interpreted net.\n\n"
+      << "#include <algorithm>\n"
+      << "#include <cmath>\n\n"
+      << "namespace {\n\n";
+
+  write_array(out, "weights", net.forward_weights(), net.n_forward_edges());
+  write_array(out, "feedback_weights", net.feedback_connection_weights(), net.n_feedback_edges());
+  write_array(out, "thresholds", net.neuron_thresholds(), size);
+
+  out << "inline double activation (double x) {\n";
+  if (net.get_tanh_mode() == tanh_mode::fast) {
+    using namespace fast_tanh_coefficients;
+    out << "  x = std::min(" << literal(clamp) << ", std::max(" << literal(-clamp) << ", x));\n"
+        << "  double x2 = x * x;\n"
+        << "  double p = x2 * " << literal(alpha_13) << " + " << literal(alpha_11) << ";\n"
+        << "  p = p * x2 + " << literal(alpha_9) << ";\n"
+        << "  p = p * x2 + " << literal(alpha_7) << ";\n"
+        << "  p = p * x2 + " << literal(alpha_5) << ";\n"
+        << "  p = p * x2 + " << literal(alpha_3) << ";\n"
+        << "  p = p * x2 + " << literal(alpha_1) << ";\n"
+        << "  p = p * x;\n"
+        << "  double q = x2 * " << literal(beta_6) << " + " << literal(beta_4) << ";\n"
+        << "  q = q * x2 + " << literal(beta_2) << ";\n"
+        << "  q = q * x2 + " << literal(beta_0) << ";\n"
+        << "  return p / q;\n";
+  } else {
+    out << "  return std::tanh(x);\n";
+  }
+  out << "}\n\n"
+      << "}\n\n";
+
+  // C ABI ------------------------------------------------------------------
+
+  out << "extern \"C\" {\n\n"
+      << "struct " << name << "_state {\n"
+      << "  double feedback[" << std::max(registers, 1u) << "];\n"
+      << "};\n\n"
+      << "unsigned " << name << "_inputs () { return " << inputs << "; }\n"
+      << "unsigned " << name << "_outputs () { return " << outputs << "; }\n\n"
+      << "void " << name << "_reset (" << name << "_state* state) {\n"
+      << "  std::fill(state->feedback, state->feedback + " << std::max(registers, 1u) << ", 0.0);\n"
+      << "}\n\n"
+      << "void " << name << "_evaluate (" << name << "_state* state, const double* inputs, double* outputs) {\n"
+      << "  const double* previous = state->feedback;\n";
+
+  // one block per neuron, in the order and with the operations of
+  // compiled_network::calculate_neuron
+  for (unsigned i = 0; i < size; i++) {
+    out << "\n";
+    if (fan_in[i] == 0) {
+      out << "  const double v" << i << " = 0;\n";
+      continue;
+    }
+    out << "  double s" << i << " = 0;\n";
+    for (unsigned k = offsets[i]; k < offsets[i + 1]; k++)
+      out << "  s" << i << " += v" << sources[k] << " * weights[" << k << "];\n";
+    for (unsigned k = feedback_offsets[i]; k < feedback_offsets[i + 1]; k++)
+      out << "  s" << i << " += previous[" << slots[feedback_sources[k]]
+          << "] * feedback_weights[" << k << "];\n";
+    if (i < inputs)
+      out << "  s" << i << " += inputs[" << i << "];\n";
+    out << "  const double v" << i << " = activation((s" << i << " / " << literal(fan_in[i])
+        << ") + thresholds[" << i << "]);\n";
+  }
+
+  out << "\n";
+  for (unsigned i = 0; i < outputs; i++)
+    out << "  outputs[" << i << "] = v" << size - outputs + i << ";\n";
+  for (unsigned r = 0; r < registers; r++)
+    out << "  state->feedback[" << r << "] = v" << origins[r] << ";\n";
+  out << "}\n\n"
+      << "}\n";
+
+  return bool(out);
+}
+
+bool write_network_source(const compiled_network& net, const std::string& name,
+                          const std::string& filename) {
+  if (!valid_identifier(name))
+    return false;
+  std::ofstream file (filename);
+  return file && generate_network_source(net, name, file) && file.flush();
+}
@@ -0,0 +1,57 @@
+/*
+ * <one line to give the program's name and a brief idea of what it does.>
+ * Copyright (C) 2018  Daniel Darias Sánchez <dariasteam94@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef CODE_GENERATOR_H
+#define CODE_GENERATOR_H
+
+#include <ostream>
+#include <string>
+
+#include "compiled_network.h"
+
+/**
+ * @brief Emits a self contained C++ source file that evaluates the net with
+ * straight line code: one block per neuron in index order with every
+ * connection unrolled, the weights and thresholds in constexpr arrays and
+ * the feedback state in a fixed size array. The file exports a C ABI:
+ *
+ *   struct <name>_state;                 one double per feedback origin
+ *   void <name>_reset (<name>_state*);
+ *   void <name>_evaluate (<name>_state*, const double* inputs, double* outputs);
+ *   unsigned <name>_inputs (), <name>_outputs ();
+ *
+ * Each evaluation is equivalent to one single sample evaluation of the net
+ * with its current #tanh_mode. Built with -ffp-contract=off and without
+ * -ffast-math it gives the same bits.
+ *
+ * @param name p_name: prefix of the exported symbols, a C identifier
+ * @return bool false if name is not a valid identifier or a weight,
+ * threshold or fan-in is not finite (a loaded image can hold any value)
+ */
+bool generate_network_source (const compiled_network& net, const std::string& name, std::ostream& out);
+
+/**
+ * @brief #generate_network_source into a file
+ *
+ * @return bool false if the name is not valid, a value is not finite or the
+ * file can not be written
+ */
+bool write_network_source (const compiled_network& net, const std::string& name,
+                           const std::string& filename);
+
+#endif // CODE_GENERATOR_H
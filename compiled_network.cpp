@@ -0,0 +1,516 @@
+/*
+ * <one line to give the program's name and a brief idea of what it does.>
+ * Copyright (C) 2018  Daniel Darias Sánchez <dariasteam94@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <cstring>
+#include <queue>
+#include <tuple>
+
+#include "compiled_network.h"
+#include "network_genome.h"
+
+static_assert(sizeof(unsigned) == sizeof(uint32_t), "indices are stored as uint32");
+
+namespace {
+
+// predecessors of the neurons alive[0..n) (all of them if alive is null) of
+// the dense matrices, read in place
+struct dense_columns {
+  const std::vector<std::vector<bool>>& graph;
+  const std::vector<std::vector<double>>& costs;
+  const unsigned* alive;
+  unsigned n;
+
+  unsigned node (unsigned i) const { return alive ? alive[i] : i; }
+
+  double threshold (unsigned j) const { return costs[node(j)][node(j)]; }
+  unsigned original (unsigned j) const { return node(j); }
+
+  template <class visitor>
+  void predecessors (unsigned j, visitor visit) const {
+    unsigned column = node(j);
+    for (unsigned i = 0; i < n; i++)
+      if (i != j && graph[node(i)][column])
+        visit(i, costs[node(i)][column]);
+  }
+};
+
+// predecessors of the neurons of a compiled net taken in a new order, each
+// one keeping the order of its sums
+struct permuted_columns {
+  const compiled_network& net;
+  const std::vector<unsigned>& order;
+  std::vector<unsigned> position;
+
+  double threshold (unsigned j) const { return net.neuron_thresholds()[order[j]]; }
+  unsigned original (unsigned j) const { return net.original_neurons()[order[j]]; }
+
+  template <class visitor>
+  void predecessors (unsigned j, visitor visit) const {
+    unsigned i = order[j];
+    const unsigned* offsets = net.predecessor_offsets();
+    const unsigned* feedback_offsets = net.feedback_predecessor_offsets();
+    for (unsigned k = offsets[i]; k < offsets[i + 1]; k++)
+      visit(position[net.predecessors()[k]], net.forward_weights()[k]);
+    for (unsigned k = feedback_offsets[i]; k < feedback_offsets[i + 1]; k++)
+      visit(position[net.feedback_predecessors()[k]], net.feedback_connection_weights()[k]);
+  }
+};
+
+// predecessors of the neurons of a genome that are alive, in its order
+struct genome_columns {
+  const network_genome& genome;
+  std::vector<unsigned> alive;
+  std::vector<unsigned> position;
+
+  double threshold (unsigned j) const { return genome.threshold(alive[j]); }
+  unsigned original (unsigned j) const { return alive[j]; }
+
+  template <class visitor>
+  void predecessors (unsigned j, visitor visit) const {
+    for (const genome_connection& connection : genome.connections(alive[j]))
+      if (position[connection.neuron] != ~0u)
+        visit(position[connection.neuron], connection.weight);
+  }
+};
+
+}
+
+compiled_network::compiled_network(const std::vector<std::vector<bool>>& vec_graph,
+                                   const std::vector<std::vector<double>>& vec_costs,
+                                   unsigned int inps, unsigned int outs) :
+                                   size(vec_graph.size()),
+                                   inputs(inps),
+                                   outputs(outs),
+                                   mode(tanh_mode::exact),
+                                   simd(&best_kernels()),
+                                   writable(false) {
+  build(dense_columns {vec_graph, vec_costs, nullptr, size}, size);
+}
+
+compiled_network::compiled_network(const std::vector<std::vector<bool>>& vec_graph,
+                                   const std::vector<std::vector<double>>& vec_costs,
+                                   const std::vector<unsigned>& alive,
+                                   unsigned int inps, unsigned int outs) :
+                                   size(alive.size()),
+                                   inputs(inps),
+                                   outputs(outs),
+                                   mode(tanh_mode::exact),
+                                   simd(&best_kernels()),
+                                   writable(false) {
+  build(dense_columns {vec_graph, vec_costs, alive.data(), size}, size);
+}
+
+compiled_network::compiled_network(const network_genome& genome) :
+                                   inputs(genome.n_inputs()),
+                                   outputs(genome.n_outputs()),
+                                   mode(tanh_mode::exact),
+                                   simd(&best_kernels()),
+                                   writable(false) {
+  genome_columns columns {genome, genome.alive_neurons(), std::vector<unsigned>(genome.size(), ~0u)};
+  size = columns.alive.size();
+  for (unsigned j = 0; j < size; j++)
+    columns.position[columns.alive[j]] = j;
+  build(columns, size);
+}
+
+template <class graph_columns>
+void compiled_network::build(const graph_columns& columns, unsigned n) {
+  // SIZE THE IMAGE ---------------------------------------------------------
+
+  uint64_t forward = 0;
+  uint64_t feedback = 0;
+  uint64_t origins = 0;
+  std::vector<bool> origin (n);
+  for (unsigned j = 0; j < n; j++) {
+    columns.predecessors(j, [&](unsigned i, double) {
+      if (i < j) {
+        forward++;
+      } else {
+        feedback++;
+        if (!origin[i]) {
+          origin[i] = true;
+          origins++;
+        }
+      }
+    });
+  }
+
+  network_file_header header;
+  std::memset(&header, 0, sizeof(header));
+  std::memcpy(header.magic, network_magic, sizeof(network_magic));
+  header.version = network_version;
+  header.size = n;
+  header.inputs = inputs;
+  header.outputs = outputs;
+  header.n_forward = forward;
+  header.n_feedback = feedback;
+  header.n_registers = origins;
+
+  uint64_t lengths[N_SECTIONS];
+  network_section_lengths(header, lengths);
+
+  uint64_t offset = network_header_size;
+  for (unsigned s = 0; s < N_SECTIONS; s++) {
+    header.sections[s] = offset;
+    offset += (lengths[s] + network_alignment - 1) / network_alignment * network_alignment;
+  }
+  header.file_size = offset;
+
+  std::shared_ptr<char> buffer = allocate_network_image(header.file_size);
+  auto section = [&](network_section s) { return buffer.get() + header.sections[s]; };
+  unsigned* row_offsets = reinterpret_cast<unsigned*>(section(ROW_OFFSETS));
+  unsigned* sources = reinterpret_cast<unsigned*>(section(SOURCES));
+  double* weights = reinterpret_cast<double*>(section(WEIGHTS));
+  unsigned* out_offsets = reinterpret_cast<unsigned*>(section(OUT_OFFSETS));
+  unsigned* targets = reinterpret_cast<unsigned*>(section(TARGETS));
+  unsigned* feedback_offsets = reinterpret_cast<unsigned*>(section(FEEDBACK_OFFSETS));
+  unsigned* feedback_sources = reinterpret_cast<unsigned*>(section(FEEDBACK_SOURCES));
+  double* feedback_weights = reinterpret_cast<double*>(section(FEEDBACK_WEIGHTS));
+  unsigned* feedback_origins = reinterpret_cast<unsigned*>(section(FEEDBACK_ORIGINS));
+  double* thresholds = reinterpret_cast<double*>(section(THRESHOLDS));
+  double* fan_in = reinterpret_cast<double*>(section(FAN_IN));
+  unsigned* neuron_ids = reinterpret_cast<unsigned*>(section(NEURON_IDS));
+
+  // FILL IT ----------------------------------------------------------------
+
+  // neurons that feed back
+  unsigned n_origins = 0;
+  for (unsigned i = 0; i < n; i++)
+    if (origin[i])
+      feedback_origins[n_origins++] = i;
+
+  // predecessors with a lower index are forward connections (upper triangle)
+  // and the ones with a higher index are feedback connections
+  unsigned n_sources = 0;
+  unsigned n_feedback_sources = 0;
+  for (unsigned j = 0; j < n; j++) {
+    thresholds[j] = columns.threshold(j);
+    neuron_ids[j] = columns.original(j);
+    row_offsets[j] = n_sources;
+    feedback_offsets[j] = n_feedback_sources;
+    columns.predecessors(j, [&](unsigned i, double weight) {
+      if (i < j) {
+        sources[n_sources] = i;
+        weights[n_sources++] = weight;
+      } else {
+        feedback_sources[n_feedback_sources] = i;
+        feedback_weights[n_feedback_sources++] = weight;
+      }
+    });
+
+    fan_in[j] = (n_sources - row_offsets[j]) +
+                (n_feedback_sources - feedback_offsets[j]) +
+                (j < inputs ? 1 : 0);
+  }
+  row_offsets[n] = n_sources;
+  feedback_offsets[n] = n_feedback_sources;
+
+  // transpose, using out_offsets[i] as the cursor of row i and shifting the
+  // offsets back into place afterwards
+  for (unsigned k = 0; k < n_sources; k++)
+    out_offsets[sources[k] + 1]++;
+  for (unsigned i = 0; i < n; i++)
+    out_offsets[i + 1] += out_offsets[i];
+  for (unsigned j = 0; j < n; j++)
+    for (unsigned k = row_offsets[j]; k < row_offsets[j + 1]; k++)
+      targets[out_offsets[sources[k]]++] = j;
+  for (unsigned i = n; i > 0; i--)
+    out_offsets[i] = out_offsets[i - 1];
+  out_offsets[0] = 0;
+
+  std::memcpy(buffer.get(), &header, sizeof(header));
+  header.checksum = network_checksum(buffer.get(), header.file_size);
+  std::memcpy(buffer.get(), &header, sizeof(header));
+
+  bind_image(buffer);
+  writable = true;
+}
+
+void compiled_network::bind_image(std::shared_ptr<const char> new_image) {
+  image = new_image;
+  const network_file_header& header = *reinterpret_cast<const network_file_header*>(image.get());
+
+  size = header.size;
+  inputs = header.inputs;
+  outputs = header.outputs;
+  n_forward = header.n_forward;
+  n_feedback = header.n_feedback;
+  n_registers = header.n_registers;
+
+  auto section = [&](network_section s) { return image.get() + header.sections[s]; };
+  row_offsets = reinterpret_cast<const unsigned*>(section(ROW_OFFSETS));
+  sources = reinterpret_cast<const unsigned*>(section(SOURCES));
+  weights = reinterpret_cast<const double*>(section(WEIGHTS));
+  out_offsets = reinterpret_cast<const unsigned*>(section(OUT_OFFSETS));
+  targets = reinterpret_cast<const unsigned*>(section(TARGETS));
+  feedback_offsets = reinterpret_cast<const unsigned*>(section(FEEDBACK_OFFSETS));
+  feedback_sources = reinterpret_cast<const unsigned*>(section(FEEDBACK_SOURCES));
+  feedback_weights = reinterpret_cast<const double*>(section(FEEDBACK_WEIGHTS));
+  feedback_origins = reinterpret_cast<const unsigned*>(section(FEEDBACK_ORIGINS));
+  thresholds = reinterpret_cast<const double*>(section(THRESHOLDS));
+  fan_in = reinterpret_cast<const double*>(section(FAN_IN));
+  neuron_ids = reinterpret_cast<const unsigned*>(section(NEURON_IDS));
+}
+
+bool compiled_network::load(const std::string& filename, compiled_network& net, bool verify) {
+  std::shared_ptr<const char> mapped = map_network_file(filename, verify);
+  if (!mapped)
+    return false;
+  net.bind_image(mapped);
+  net.writable = false;
+  return true;
+}
+
+bool compiled_network::save(const std::string& filename) const {
+  if (!image)
+    return false;
+  // set_weight does not keep the checksum
+  network_file_header header = *reinterpret_cast<const network_file_header*>(image.get());
+  header.checksum = network_checksum(image.get(), header.file_size);
+  return write_network_file(filename, image.get(), header);
+}
+
+bool compiled_network::set_weight(unsigned from, unsigned to, double weight) {
+  if (from >= size || to >= size)
+    return false;
+
+  const double* target = nullptr;
+  if (from == to) {
+    target = &thresholds[to];
+  } else if (from < to) {
+    for (unsigned k = row_offsets[to]; k < row_offsets[to + 1]; k++)
+      if (sources[k] == from)
+        target = &weights[k];
+  } else {
+    for (unsigned k = feedback_offsets[to]; k < feedback_offsets[to + 1]; k++)
+      if (feedback_sources[k] == from)
+        target = &feedback_weights[k];
+  }
+  if (!target)
+    return false;
+
+  // copy on write
+  if (!writable || image.use_count() > 1) {
+    uint64_t offset = reinterpret_cast<const char*>(target) - image.get();
+    std::shared_ptr<char> buffer = allocate_network_image(image_size());
+    std::memcpy(buffer.get(), image.get(), image_size());
+    bind_image(buffer);
+    writable = true;
+    target = reinterpret_cast<const double*>(image.get() + offset);
+  }
+  *const_cast<double*>(target) = weight;
+  return true;
+}
+
+uint64_t compiled_network::image_size() const {
+  return image ? reinterpret_cast<const network_file_header*>(image.get())->file_size : 0;
+}
+
+void compiled_network::move_image(std::shared_ptr<char> buffer) {
+  if (!image)
+    return;
+  std::memcpy(buffer.get(), image.get(), image_size());
+  bind_image(buffer);
+  writable = true;
+}
+
+std::vector<unsigned> compiled_network::locality_order() const {
+  unsigned first_output = size - outputs;
+  auto hidden = [&](unsigned i) { return i >= inputs && i < first_output; };
+
+  // longest forward path from a neuron without predecessors
+  std::vector<unsigned> levels (size, 0);
+  for (unsigned j = 0; j < size; j++)
+    for (unsigned k = row_offsets[j]; k < row_offsets[j + 1]; k++)
+      levels[j] = std::max(levels[j], levels[sources[k]] + 1);
+
+  // a hidden neuron is placed after its forward predecessors and after the
+  // destinations of its feedback connections
+  std::vector<unsigned> pending (size, 0);
+  for (unsigned j = inputs; j < first_output; j++) {
+    for (unsigned k = row_offsets[j]; k < row_offsets[j + 1]; k++)
+      if (hidden(sources[k]))
+        pending[j]++;
+    for (unsigned k = feedback_offsets[j]; k < feedback_offsets[j + 1]; k++)
+      if (hidden(feedback_sources[k]))
+        pending[feedback_sources[k]]++;
+  }
+
+  std::vector<unsigned> order;
+  std::vector<unsigned> position (size, size);
+  order.reserve(size);
+  for (unsigned i = 0; i < inputs; i++) {
+    position[i] = i;
+    order.push_back(i);
+  }
+
+  // ready neurons by level, then by the position of their first predecessor
+  typedef std::tuple<unsigned, unsigned, unsigned> candidate;
+  std::priority_queue<candidate, std::vector<candidate>, std::greater<candidate>> ready;
+  auto push = [&](unsigned j) {
+    unsigned first = size;
+    for (unsigned k = row_offsets[j]; k < row_offsets[j + 1]; k++)
+      first = std::min(first, position[sources[k]]);
+    ready.push(candidate(levels[j], first, j));
+  };
+  auto release = [&](unsigned j) {
+    if (hidden(j) && --pending[j] == 0)
+      push(j);
+  };
+
+  for (unsigned j = inputs; j < first_output; j++)
+    if (pending[j] == 0)
+      push(j);
+
+  while (!ready.empty()) {
+    unsigned i = std::get<2>(ready.top());
+    ready.pop();
+    position[i] = order.size();
+    order.push_back(i);
+
+    for (unsigned k = out_offsets[i]; k < out_offsets[i + 1]; k++)
+      release(targets[k]);
+    for (unsigned k = feedback_offsets[i]; k < feedback_offsets[i + 1]; k++)
+      release(feedback_sources[k]);
+  }
+
+  for (unsigned i = first_output; i < size; i++)
+    order.push_back(i);
+  return order;
+}
+
+bool compiled_network::permuted(const std::vector<unsigned>& order, compiled_network& net) const {
+  if (order.size() != size)
+    return false;
+
+  std::vector<unsigned> position (size, size);
+  for (unsigned k = 0; k < size; k++) {
+    if (order[k] >= size || position[order[k]] != size)
+      return false;
+    position[order[k]] = k;
+  }
+
+  // inputs and outputs stay in place and no connection changes direction
+  for (unsigned i = 0; i < size; i++) {
+    if ((i < inputs || i >= size - outputs) && position[i] != i)
+      return false;
+    for (unsigned k = row_offsets[i]; k < row_offsets[i + 1]; k++)
+      if (position[sources[k]] >= position[i])
+        return false;
+    for (unsigned k = feedback_offsets[i]; k < feedback_offsets[i + 1]; k++)
+      if (position[feedback_sources[k]] <= position[i])
+        return false;
+  }
+
+  net = compiled_network();
+  net.size = size;
+  net.inputs = inputs;
+  net.outputs = outputs;
+  net.mode = mode;
+  net.simd = simd;
+  net.build(permuted_columns {*this, order, position}, size);
+  return true;
+}
+
+void compiled_network::capture_state(const evaluation_context& context,
+                                     std::vector<double>& state) const {
+  state.resize(n_registers);
+  for (unsigned r = 0; r < n_registers; r++)
+    state[r] = context.activations[feedback_origins[r]];
+}
+
+bool compiled_network::restore_state(evaluation_context& context,
+                                     const std::vector<double>& state) const {
+  if (state.size() != n_registers)
+    return false;
+  context.activations.assign(size, 0);
+  context.previous.assign(size, 0);
+  context.history = activation_history::none;
+  for (unsigned r = 0; r < n_registers; r++)
+    context.activations[feedback_origins[r]] = state[r];
+  return true;
+}
+
+void compiled_network::set_inputs(evaluation_context& context,
+                                  const std::vector<double>& inputs_values) const {
+  for (unsigned i = 0; i < inputs; i++)
+    context.external[i] = inputs_values[i];
+}
+
+void compiled_network::get_outputs(const evaluation_context& context,
+                                   std::vector<double>& outputs_values) const {
+  outputs_values.resize(outputs);
+  for (unsigned i = 0; i < outputs; i++)
+    outputs_values[i] = context.activations[size - outputs + i];
+}
+
+void compiled_network::set_batch_inputs(evaluation_context& context,
+                                        const std::vector<std::vector<double>>& inputs_batch) const {
+  unsigned batch = inputs_batch.size();
+  context.batch = batch;
+  context.batch_sequences = false;
+  context.batch_activations.resize(size * batch);
+  context.batch_external.resize(inputs * batch);
+  for (unsigned b = 0; b < batch; b++)
+    for (unsigned i = 0; i < inputs; i++)
+      context.batch_external[i * batch + b] = inputs_batch[b][i];
+}
+
+void compiled_network::get_batch_outputs(const evaluation_context& context,
+                                         std::vector<std::vector<double>>& outputs_batch) const {
+  unsigned batch = context.batch;
+  outputs_batch.resize(batch);
+  for (unsigned b = 0; b < batch; b++) {
+    outputs_batch[b].resize(outputs);
+    for (unsigned i = 0; i < outputs; i++)
+      outputs_batch[b][i] = context.batch_activations[(size - outputs + i) * batch + b];
+  }
+}
+
+void compiled_network::start_batch_sequences(evaluation_context& context, unsigned sequences) const {
+  context.batch = sequences;
+  context.batch_sequences = true;
+  context.batch_activations.resize(size * sequences);
+  context.batch_previous.resize(size * sequences);
+  context.batch_external.resize(inputs * sequences);
+  // swapped into batch_previous by the first timestep
+  for (unsigned i = 0; i < size; i++)
+    std::fill(&context.batch_activations[i * sequences],
+              &context.batch_activations[i * sequences] + sequences, context.activations[i]);
+}
+
+void compiled_network::set_batch_step_inputs(evaluation_context& context,
+                                             const std::vector<std::vector<std::vector<double>>>& inputs_sequences,
+                                             unsigned t) const {
+  unsigned batch = context.batch;
+  for (unsigned b = 0; b < batch; b++)
+    for (unsigned i = 0; i < inputs; i++)
+      context.batch_external[i * batch + b] = inputs_sequences[b][t][i];
+}
+
+void compiled_network::get_batch_step_outputs(const evaluation_context& context,
+                                              std::vector<std::vector<std::vector<double>>>& outputs_sequences,
+                                              unsigned t) const {
+  unsigned batch = context.batch;
+  for (unsigned b = 0; b < batch; b++) {
+    std::vector<double>& step = outputs_sequences[b][t];
+    step.resize(outputs);
+    for (unsigned i = 0; i < outputs; i++)
+      step[i] = context.batch_activations[(size - outputs + i) * batch + b];
+  }
+}
@@ -0,0 +1,406 @@
+/*
+ * <one line to give the program's name and a brief idea of what it does.>
+ * Copyright (C) 2018  Daniel Darias Sánchez <dariasteam94@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef COMPILED_NETWORK_H
+#define COMPILED_NETWORK_H
+
+#include <algorithm>
+#include <cmath>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "evaluation_context.h"
+#include "kernels.h"
+#include "net_io.h"
+
+class network_genome;
+
+/**
+ * @brief Flat representation of an already pruned net. The predecessors of
+ * every neuron are stored in CSR form (row offsets + source indices + weights)
+ * so the evaluation walks contiguous arrays instead of axon / neuron objects.
+ *
+ * Feedback connections (lower triangle) read the value of their origin neuron
+ * during the previous evaluation, which is what #feedback_bus used to do with
+ * a pair of axons per connection. The context keeps the activations of the
+ * current and the previous evaluation in two flat buffers that are swapped at
+ * every timestep, so the recurrent state is never copied.
+ *
+ * Each neuron is calculated as tanh (sum / fan_in + threshold), accumulating
+ * first the forward predecessors, then the feedback ones and finally the
+ * external input (input neurons only). Neurons without any input output 0.
+ *
+ * The compiled net is read only: everything an evaluation writes lives in an
+ * #evaluation_context. Batches of samples keep their own activations, neuron
+ * major, so the values of one neuron for the whole batch are contiguous. Every
+ * sample of a plain batch reads the feedback of the last single evaluation and
+ * the batch does not modify it. A batch of sequences keeps a previous buffer of
+ * its own so each sample carries its own recurrent state between timesteps.
+ * The batch dimension is processed with the vector kernels of #kernel_set.
+ *
+ * The arrays that describe the net live in a single read only image laid out
+ * as a binary net file (see #network_file_header). The image is sized from
+ * the pruned graph before filling it, so compiling a net makes exactly one
+ * allocation, which is freed when the last copy sharing it is destroyed.
+ * Loading a saved net maps the file with no parsing or copying. The only
+ * change allowed in place is #set_weight, which first copies the image if it
+ * is shared with another copy of the net or mapped from a file.
+ */
+class compiled_network {
+private:
+  unsigned size;
+  unsigned inputs;
+  unsigned outputs;
+
+  std::shared_ptr<const char> image;
+
+  // forward predecessors (upper triangle)
+  const unsigned* row_offsets;
+  const unsigned* sources;
+  const double* weights;
+
+  // forward sucessors, the transpose of the above
+  const unsigned* out_offsets;
+  const unsigned* targets;
+
+  // feedback predecessors (lower triangle), sources are read from the
+  // previous activations. origins lists the neurons with feedback sucessors
+  const unsigned* feedback_offsets;
+  const unsigned* feedback_sources;
+  const double* feedback_weights;
+  const unsigned* feedback_origins;
+
+  const double* thresholds;
+  const double* fan_in;
+
+  // index of every neuron in the matrices or edges it was compiled from
+  const unsigned* neuron_ids;
+
+  unsigned n_forward;
+  unsigned n_feedback;
+  unsigned n_registers;
+
+  tanh_mode mode;
+  const kernel_set* simd;
+
+  // the image was allocated by this net and can be written
+  bool writable;
+
+  /**
+   * @brief Points every array to its section of the image
+   */
+  void bind_image (std::shared_ptr<const char> new_image);
+
+  /**
+   * @brief Lowers a net of n neurons into a new image. columns gives the
+   * threshold and the original index of every neuron and visits its
+   * predecessors in the order they are summed, so dense, genome and
+   * permuted inputs share the same lowering.
+   */
+  template <class graph_columns>
+  void build (const graph_columns& columns, unsigned n);
+
+public:
+  compiled_network () : size(0), inputs(0), outputs(0),
+                        row_offsets(nullptr), sources(nullptr), weights(nullptr),
+                        out_offsets(nullptr), targets(nullptr),
+                        feedback_offsets(nullptr), feedback_sources(nullptr),
+                        feedback_weights(nullptr), feedback_origins(nullptr),
+                        thresholds(nullptr), fan_in(nullptr), neuron_ids(nullptr),
+                        n_forward(0), n_feedback(0), n_registers(0),
+                        mode(tanh_mode::exact), simd(&best_kernels()), writable(false) {}
+
+  /**
+   * @brief Lowers a pruned net into contiguous arrays
+   *
+   * @param vec_graph p_vec_graph: adjacency matrix of the net
+   * @param vec_costs p_vec_costs: weights of the net, thresholds in the diagonal
+   * @param inps p_inps: number of input neurons
+   * @param outs p_outs: number of output neurons
+   */
+  compiled_network (const std::vector<std::vector<bool>>& vec_graph,
+                    const std::vector<std::vector<double>>& vec_costs,
+                    unsigned inps, unsigned outs);
+
+  /**
+   * @brief Lowers only the given neurons of a net, usually the ones returned
+   * by #concurrent_neural_network::find_useful_nodes, so the matrices do not
+   * need to be compacted first
+   *
+   * @param alive p_alive: sorted indices of the neurons to keep
+   */
+  compiled_network (const std::vector<std::vector<bool>>& vec_graph,
+                    const std::vector<std::vector<double>>& vec_costs,
+                    const std::vector<unsigned>& alive,
+                    unsigned inps, unsigned outs);
+
+  /**
+   * @brief Lowers the neurons of the genome that are alive (see
+   * #network_genome::alive), numbered in the order of the genome
+   */
+  explicit compiled_network (const network_genome& genome);
+
+  /**
+   * @brief Maps a net saved with #save
+   *
+   * @param verify p_verify: check the checksum, which reads the whole file
+   * @return bool false if the file could not be mapped or is not valid
+   */
+  static bool load (const std::string& filename, compiled_network& net, bool verify = true);
+
+  /**
+   * @brief Writes the image with its checksum updated
+   */
+  bool save (const std::string& filename) const;
+
+  /**
+   * @brief Changes the weight of the connection (from, to), or the
+   * threshold of the neuron if both are the same, without compiling the net
+   * again. The copies of the net made before keep the old weight.
+   *
+   * @return bool false if there is no such connection
+   */
+  bool set_weight (unsigned from, unsigned to, double weight);
+
+  /**
+   * @brief Size in bytes of the image that holds the arrays of the net
+   */
+  uint64_t image_size () const;
+
+  /**
+   * @brief Copies the image into buffer, which must hold #image_size bytes,
+   * and reads the net from there on. Used to move a net to the memory of a
+   * NUMA node; the copies of the net made before keep the old image.
+   */
+  void move_image (std::shared_ptr<char> buffer);
+
+  /**
+   * @brief Order of the neurons that improves the locality of the
+   * evaluation, for #permuted. The neurons are numbered level by level (see
+   * #concurrent_neural_network::generate_levels), so the neurons calculated
+   * together are contiguous, and inside a level by their first predecessor,
+   * as in a Cuthill-McKee ordering, so consecutive neurons read nearby
+   * activations. Inputs and outputs keep their indices, and the order remains
+   * topological for the forward connections and reverse topological for the
+   * feedback ones, so every executor still sees a valid net.
+   *
+   * @return std::vector< unsigned int > current index of the neuron placed
+   * at each position
+   */
+  std::vector<unsigned> locality_order () const;
+
+  /**
+   * @brief Copies the net into net with the neurons renumbered: neuron k of
+   * the new net is neuron order[k] of this one. Every neuron keeps the order
+   * of its sums, so both nets calculate exactly the same values, and the
+   * original indices (#original_neurons) follow the neurons.
+   *
+   * @return bool false if order is not a permutation that keeps the inputs
+   * and outputs in place and the direction of every connection
+   */
+  bool permuted (const std::vector<unsigned>& order, compiled_network& net) const;
+
+  /**
+   * @brief Starts a new timestep: the values calculated in the last
+   * evaluation become the previous ones read by the feedback connections. The
+   * two buffers are swapped, nothing is copied. Must be called before
+   * setting the new inputs.
+   */
+  void propagate_feedback (evaluation_context& context) const {
+    context.activations.swap(context.previous);
+    context.history = activation_history::full;
+  }
+
+  /**
+   * @brief Copies the recurrent state of the context, the last value of every
+   * neuron in #feedback_register_origins, into state. That is all the next
+   * evaluation reads from the previous ones.
+   */
+  void capture_state (const evaluation_context& context, std::vector<double>& state) const;
+
+  /**
+   * @brief Sets the recurrent state of the context from a #capture_state
+   * buffer. The rest of the activations are set to 0.
+   *
+   * @return bool false if the state does not belong to this net
+   */
+  bool restore_state (evaluation_context& context, const std::vector<double>& state) const;
+
+  /**
+   * @brief Whether the buffers of the context have the size of this net, so
+   * it can be evaluated with it. Contexts created for the net before it was
+   * compiled again or reordered usually do not.
+   */
+  bool fits (const evaluation_context& context) const {
+    return context.activations.size() == size && context.previous.size() == size &&
+           context.external.size() == inputs;
+  }
+
+  void set_inputs (evaluation_context& context, const std::vector<double>& inputs_values) const;
+  void get_outputs (const evaluation_context& context, std::vector<double>& outputs_values) const;
+
+  /**
+   * @brief Update of neuron i shared by the evaluations in every number type
+   * (double, #typed_network and #quantized_network). The forward
+   * predecessors are read from current and the feedback ones from previous,
+   * weighted and summed in A. to_value converts the sum of neuron i to X,
+   * the external input is added, and the result is averaged over the fan-in
+   * and moved by the threshold before activate gives the value of i.
+   * Neurons without fan-in are 0.
+   */
+  template <typename R, typename A, typename X, typename V, typename W, class convert, class activate>
+  R update_neuron (unsigned i, const V* current, const V* previous,
+                   const W* forward, const W* feedback,
+                   const X* external, const X* fan_ins, const X* biases,
+                   convert to_value, activate f) const {
+    if (fan_ins[i] == 0)
+      return R(0);
+
+    A sum = 0;
+    for (unsigned k = row_offsets[i]; k < row_offsets[i + 1]; k++)
+      sum += A(current[sources[k]]) * forward[k];
+    for (unsigned k = feedback_offsets[i]; k < feedback_offsets[i + 1]; k++)
+      sum += A(previous[feedback_sources[k]]) * feedback[k];
+
+    X value = to_value(sum, i);
+    if (i < inputs)
+      value += external[i];
+    return f((value / fan_ins[i]) + biases[i], i);
+  }
+
+  /**
+   * @brief Value of neuron i, reading its forward predecessors from the
+   * activations of the context and its feedback predecessors from feedback.
+   * All its forward predecessors must have been calculated before.
+   */
+  double neuron_value (const evaluation_context& context, unsigned i, const double* feedback) const {
+    return update_neuron<double, double>(i, context.activations.data(), feedback,
+                                         weights, feedback_weights,
+                                         context.external.data(), fan_in, thresholds,
+                                         [](double sum, unsigned) { return sum; },
+                                         [this](double x, unsigned) { return activation(x, mode); });
+  }
+
+  /**
+   * @brief Calculates the value of neuron i. All its forward predecessors
+   * must have been calculated before.
+   */
+  void calculate_neuron (evaluation_context& context, unsigned i) const {
+    context.activations[i] = neuron_value(context, i, context.previous.data());
+  }
+
+  /**
+   * @brief Same as #set_inputs for a batch, one row per sample. It also
+   * resizes the batch activations of the context.
+   */
+  void set_batch_inputs (evaluation_context& context,
+                         const std::vector<std::vector<double>>& inputs_batch) const;
+  void get_batch_outputs (const evaluation_context& context,
+                          std::vector<std::vector<double>>& outputs_batch) const;
+
+  /**
+   * @brief Prepares the context to run a batch of independent sequences.
+   * Every sequence starts from the recurrent state of the last single
+   * evaluation, which is not modified.
+   *
+   * @param sequences p_sequences: number of sequences (samples of the batch)
+   */
+  void start_batch_sequences (evaluation_context& context, unsigned sequences) const;
+
+  /**
+   * @brief #propagate_feedback for a batch of sequences
+   */
+  void propagate_batch_feedback (evaluation_context& context) const {
+    context.batch_activations.swap(context.batch_previous);
+  }
+
+  /**
+   * @brief Sets the inputs of timestep t of every sequence
+   *
+   * @param inputs_sequences p_inputs_sequences: sequences x T x inputs
+   */
+  void set_batch_step_inputs (evaluation_context& context,
+                              const std::vector<std::vector<std::vector<double>>>& inputs_sequences,
+                              unsigned t) const;
+  void get_batch_step_outputs (const evaluation_context& context,
+                               std::vector<std::vector<std::vector<double>>>& outputs_sequences,
+                               unsigned t) const;
+
+  /**
+   * @brief Calculates the value of neuron i for every sample of the batch
+   */
+  void calculate_neuron_batch (evaluation_context& context, unsigned i) const {
+    unsigned batch = context.batch;
+    const double* batch_activations = context.batch_activations.data();
+    double* values = &context.batch_activations[i * batch];
+    std::fill(values, values + batch, 0.0);
+
+    for (unsigned k = row_offsets[i]; k < row_offsets[i + 1]; k++)
+      simd->accumulate(values, &batch_activations[sources[k] * batch], weights[k], batch);
+    if (context.batch_sequences) {
+      const double* batch_previous = context.batch_previous.data();
+      for (unsigned k = feedback_offsets[i]; k < feedback_offsets[i + 1]; k++)
+        simd->accumulate(values, &batch_previous[feedback_sources[k] * batch], feedback_weights[k], batch);
+    } else {
+      for (unsigned k = feedback_offsets[i]; k < feedback_offsets[i + 1]; k++)
+        simd->add_constant(values, context.activations[feedback_sources[k]] * feedback_weights[k], batch);
+    }
+    if (i < inputs)
+      simd->add(values, &context.batch_external[i * batch], batch);
+
+    if (fan_in[i] == 0)
+      std::fill(values, values + batch, 0.0);
+    else
+      simd->activate(values, batch, fan_in[i], thresholds[i], mode);
+  }
+
+  void set_tanh_mode (tanh_mode m) { mode = m; }
+  void set_kernels (const kernel_set& k) { simd = &k; }
+
+  unsigned n_neurons () const { return size; }
+  unsigned n_inputs () const { return inputs; }
+  unsigned n_outputs () const { return outputs; }
+  unsigned n_edges () const { return n_forward + n_feedback; }
+
+  unsigned n_forward_edges () const { return n_forward; }
+  unsigned n_feedback_edges () const { return n_feedback; }
+  unsigned n_feedback_registers () const { return n_registers; }
+  tanh_mode get_tanh_mode () const { return mode; }
+  const kernel_set& kernels () const { return *simd; }
+
+  const unsigned* predecessor_offsets () const { return row_offsets; }
+  const unsigned* predecessors () const { return sources; }
+  const unsigned* sucessor_offsets () const { return out_offsets; }
+  const unsigned* sucessors () const { return targets; }
+  const double* forward_weights () const { return weights; }
+  const unsigned* feedback_predecessor_offsets () const { return feedback_offsets; }
+  const unsigned* feedback_predecessors () const { return feedback_sources; }
+  const double* feedback_connection_weights () const { return feedback_weights; }
+  const unsigned* feedback_register_origins () const { return feedback_origins; }
+  const double* neuron_thresholds () const { return thresholds; }
+  const double* neuron_fan_in () const { return fan_in; }
+
+  /**
+   * @brief Index of every neuron in the matrices or edges the net was built
+   * from, before pruning and reordering
+   */
+  const unsigned* original_neurons () const { return neuron_ids; }
+};
+
+#endif // COMPILED_NETWORK_H
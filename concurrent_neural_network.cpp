@@ -17,266 +17,786 @@
  */
 
 #include "concurrent_neural_network.h"
+#include "numa_placement.h"
 
 concurrent_neural_network::concurrent_neural_network(const std::vector<std::vector<bool>>& vec_graph,
                                                      const std::vector<std::vector<double>>& vec_costs,
-                                                     unsigned int inps, unsigned int outs) :
+                                                     unsigned int inps, unsigned int outs,
+                                                     thread_pool* p) :
                                                      inputs(inps),
-                                                     outputs(outs) {
+                                                     outputs(outs),
+                                                     reordered(false),
+                                                     parallel_threshold(256),
+                                                     mode(execution_mode::steps),
+                                                     epsilon(0) {
 
-    auto net_graph = vec_graph;
-    auto net_costs = vec_costs;
-
-    unsigned old_size = 0;
-    unsigned new_size = 0;
-    unsigned counter = 0;
+    set_thread_pool(p);
 
     //  OPTIMIZE THE NET  -----------------------------------------------------
 
-    do {
-      counter++;
-      old_size = net_graph.size();
-      delete_unreachable_nodes(net_graph, net_costs, 3, 2);
-      delete_deathend_nodes(net_graph, net_costs, 3, 2);
-      new_size = net_graph.size();
-    } while (old_size != new_size);
+    // the genome finds the useful neurons
+    genome = std::make_shared<network_genome>(vec_graph, vec_costs, inputs, outputs);
+
+    // COMPILE THE NET --------------------------------------------------------
+
+    net = compiled_network(*genome);
+    index_neurons();
 
     // CALCULATE CONCURRENT NEURONS -------------------------------------------
 
-    concurrent_steps = generate_concurrent_steps(net_graph);
+    build_schedule();
+  }
 
-    // BUILD THE NET ----------------------------------------------------------
+concurrent_neural_network::concurrent_neural_network(const std::vector<network_edge>& edges,
+                                                     const std::vector<double>& vec_thresholds,
+                                                     unsigned int inps, unsigned int outs,
+                                                     thread_pool* p) :
+                                                     inputs(inps),
+                                                     outputs(outs),
+                                                     reordered(false),
+                                                     parallel_threshold(256),
+                                                     mode(execution_mode::steps),
+                                                     epsilon(0) {
 
-    unsigned size = net_graph.size();
-    neurons.resize(size);
+    set_thread_pool(p);
 
-    // regular neurons
-    for (unsigned i = 0; i < size - outs; i++)
-      neurons[i] = new neuron();
+    //  OPTIMIZE THE NET  -----------------------------------------------------
 
-    // output neurons (can check no inputs)
-    for (unsigned i = size - outs; i < size; i++)
-      neurons[i] = new output_neuron();
+    genome = std::make_shared<network_genome>(edges, vec_thresholds, inputs, outputs);
 
+    // COMPILE THE NET --------------------------------------------------------
 
-    // Generate the net
-    for (unsigned i = 0; i < size; i++) {
-      // diagonal (threshold)
-      neurons[i]->set_threshold(net_costs[i][i]);
-
-      // upper triangle (propagative)
-      for (unsigned j = i + 1; j < size; j++) {
-        if (net_graph[i][j]) {
-          axon* aux = new axon(net_costs[i][j]);
-          neurons[i]->add_output(aux);
-          neurons[j]->add_input(aux);
-        }
-      }
-      // lower triangle (feedbacker)
-      for (unsigned j = 0; j < i; j++) {
-        if (net_graph[i][j]) {
-          add_feedbacker(i, j, net_costs[i][j]);
-        }
-      }
-    }
+    net = compiled_network(*genome);
+    index_neurons();
 
-    // Generate the inputs axons
-    input_axons.resize(inputs);
-    for (unsigned i = 0; i < inputs; i++) {
-      axon* aux = new axon(1);
-      neurons[i]->add_input(aux);
-      input_axons[i] = aux;
-    }
+    // CALCULATE CONCURRENT NEURONS -------------------------------------------
 
-    // Generate the outputs axons
-    output_axons.resize(outputs);
-    for (unsigned i = 0; i < outputs; i++) {
-      axon* aux = new axon(1);
-      neurons[size - outputs + i]->add_output(aux);
-      output_axons[i] = aux;
-    }
+    build_schedule();
+  }
+
+concurrent_neural_network::concurrent_neural_network(const compiled_network& compiled,
+                                                     thread_pool* p) :
+                                                     inputs(compiled.n_inputs()),
+                                                     outputs(compiled.n_outputs()),
+                                                     net(compiled),
+                                                     reordered(false),
+                                                     parallel_threshold(256),
+                                                     mode(execution_mode::steps),
+                                                     epsilon(0) {
+    set_thread_pool(p);
+    build_schedule();
   }
 
-bool concurrent_neural_network::operator()(const std::vector< double >& inputs_values,
-                                           std::vector< double >& outputs_values) {
+concurrent_neural_network::concurrent_neural_network(const concurrent_neural_network& other) :
+                                                     inputs(other.inputs),
+                                                     outputs(other.outputs),
+                                                     net(other.net),
+                                                     genome(other.genome),
+                                                     compiled_index(other.compiled_index),
+                                                     reordered(other.reordered),
+                                                     levels(other.levels),
+                                                     schedule(other.schedule),
+                                                     concurrent_steps(other.concurrent_steps),
+                                                     parallel_threshold(other.parallel_threshold),
+                                                     pool(other.pool),
+                                                     mode(other.mode),
+                                                     dataflow(other.dataflow),
+                                                     incremental(other.incremental),
+                                                     epsilon(other.epsilon),
+                                                     plans(other.plans),
+                                                     stats(std::make_shared<stats_recorder>()),
+                                                     context(other.context) {
+  stats->resize(concurrent_steps.size());
+  stats->set_enabled(other.stats->active());
+}
 
-    propagate_feedback();
+concurrent_neural_network& concurrent_neural_network::operator=(const concurrent_neural_network& other) {
+  if (this != &other) {
+    concurrent_neural_network copy (other);
+    *this = std::move(copy);
+  }
+  return *this;
+}
+
+void concurrent_neural_network::build_schedule() {
+  context = evaluation_context(net);
+  dataflow.bind(net);
+  incremental.bind(net);
+  plans = std::make_shared<output_plan_cache>();
+  generate_levels();
+  generate_concurrent_steps();
+  stats = std::make_shared<stats_recorder>();
+  stats->resize(concurrent_steps.size());
+}
+
+bool concurrent_neural_network::operator()(evaluation_context& ctx,
+                                           const std::vector< double >& inputs_values,
+                                           std::vector< double >& outputs_values) const {
 
     // Comprobar compatibilidad de los vectores
     unsigned i_size = inputs_values.size();
-    unsigned o_size = outputs;
-    if (i_size != inputs)
+    if (i_size != inputs || !net.fits(ctx))
       return false;
 
-    // Establecer los inputs
-    for (unsigned i = 0; i < i_size; i++)
-      input_axons[i]->set_value(inputs_values[i]);
+#ifdef CNN_INSTRUMENTATION
+    if (stats->active()) {
+      instrumented_call(ctx, inputs_values, outputs_values);
+      return true;
+    }
+#endif
 
+    // Realizar el cálculo concurrente
+    step(ctx, inputs_values);
 
-    std::vector<std::future<void>> promises (neurons.size());
-    auto calculate_neuron = [&](unsigned i) {
-      neurons[i]->calculate_value();
-      neurons[i]->propagate_value();
-    };
+    // Recoger los outputs
+    net.get_outputs(ctx, outputs_values);
 
-    // Realizar el cálculo concurrente
-    unsigned last_neuron = 0;
-    for (unsigned concurrent_group : concurrent_steps) {
-      for (unsigned i = last_neuron; i <= concurrent_group; i++)
-        promises[i] = std::async(calculate_neuron, i);
+    return true;
+  }
 
-      for (unsigned i = last_neuron; i < concurrent_group; i++)
-        promises[i].get();
+bool concurrent_neural_network::operator()(evaluation_context& ctx,
+                                           const std::vector<std::vector<double>>& inputs_batch,
+                                           std::vector<std::vector<double>>& outputs_batch) const {
 
-      last_neuron = concurrent_group + 1;
+    if (!net.fits(ctx))
+      return false;
+    for (auto& inputs_values : inputs_batch)
+      if (inputs_values.size() != inputs)
+        return false;
+
+#ifdef CNN_INSTRUMENTATION
+    if (stats->active()) {
+      instrumented_batch(ctx, inputs_batch, outputs_batch);
+      return true;
     }
+#endif
 
-    // Recoger los outputs
-    outputs_values.resize(o_size);
-    for (unsigned i = 0; i < o_size; i++)
-      outputs_values[i] = output_axons[i]->get_value();
+    net.set_batch_inputs(ctx, inputs_batch);
+
+    evaluate(ctx, true);
+
+    net.get_batch_outputs(ctx, outputs_batch);
 
     return true;
   }
 
-void concurrent_neural_network::propagate_feedback(){
-  for (auto& feedbacker : feedbackers)
-    feedbacker.second->propagate_value();
-}
+bool concurrent_neural_network::operator()(evaluation_context& ctx,
+                                           const std::vector<bool>& requested,
+                                           const std::vector<double>& inputs_values,
+                                           std::vector<double>& outputs_values) const {
 
-void concurrent_neural_network::add_feedbacker(unsigned int origin_neuron, unsigned int destiny_neuron, double w){
-  if (feedbackers.find(origin_neuron) == feedbackers.end())
-    feedbackers[destiny_neuron] = new feedback_bus(neurons[destiny_neuron]);
-  feedbackers[destiny_neuron]->add_connection(neurons[origin_neuron], w);
-}
+    if (requested.size() != outputs || inputs_values.size() != inputs || !net.fits(ctx))
+      return false;
 
+    std::shared_ptr<const output_plan> plan = find_plan(requested);
 
-void concurrent_neural_network::delete_unreachable_nodes(std::vector<std::vector<bool>>& vec_graph,
-                                                         std::vector<std::vector<double>>& vec_costs,
-                                                         unsigned int inputs, unsigned int outputs) {
+    // only the feedback read by the cone moves to the previous timestep, the
+    // rest of the neurons keep their last value in both buffers
+    for (unsigned origin : plan->origins)
+      ctx.previous[origin] = ctx.activations[origin];
+    ctx.history = activation_history::none;
 
-  unsigned size = vec_graph.size();
+    net.set_inputs(ctx, inputs_values);
 
-  unsigned j;
+    run_steps(ctx, false, plan->schedule, plan->steps);
 
-  std::stack<unsigned> sucesors;
-  for (unsigned i = size - outputs - 1; i >= inputs; i--)
-    sucesors.push(i);
+    unsigned size = net.n_neurons();
+    outputs_values.assign(outputs, 0);
+    for (unsigned i = 0; i < outputs; i++)
+      if (requested[i])
+        outputs_values[i] = ctx.activations[size - outputs + i];
 
-  std::vector<bool> has_predecesor (size);
+    return true;
+  }
 
-  while (sucesors.size() != 0) {
-    // find next valid candidate in the stack
-    do {
-      if (sucesors.size() == 0)
-        return;
-      j = sucesors.top();
-      sucesors.pop();
-    } while (j < inputs || j > size - outputs - 1);
+std::shared_ptr<const output_plan> concurrent_neural_network::find_plan(const std::vector<bool>& requested) const {
+  std::lock_guard<std::mutex> lock (plans->mutex);
+  std::shared_ptr<const output_plan>& cached = plans->plans[requested];
+  if (cached)
+    return cached;
+
+  unsigned size = net.n_neurons();
+  const unsigned* offsets = net.predecessor_offsets();
+  const unsigned* predecessors = net.predecessors();
+  const unsigned* feedback_offsets = net.feedback_predecessor_offsets();
+  const unsigned* feedback_predecessors = net.feedback_predecessors();
+
+  // backward search from the requested outputs, as the one of
+  // find_useful_nodes but following the feedback connections too
+  std::vector<bool> reached (size);
+  std::stack<unsigned> pending;
+  for (unsigned i = 0; i < outputs; i++) {
+    if (requested[i]) {
+      reached[size - outputs + i] = true;
+      pending.push(size - outputs + i);
+    }
+  }
+  auto reach = [&](unsigned j) {
+    if (!reached[j]) {
+      reached[j] = true;
+      pending.push(j);
+    }
+  };
+  while (!pending.empty()) {
+    unsigned i = pending.top();
+    pending.pop();
+    for (unsigned k = offsets[i]; k < offsets[i + 1]; k++)
+      reach(predecessors[k]);
+    for (unsigned k = feedback_offsets[i]; k < feedback_offsets[i + 1]; k++)
+      reach(feedback_predecessors[k]);
+  }
 
-    bool empty_column = true;
-    for (int i = j - 1; i >= 0; i--) {
-      if (vec_graph[i][j]) {
-        empty_column = false;
-        i = 0;
-      }
+  std::shared_ptr<output_plan> plan = std::make_shared<output_plan>();
+  for (unsigned i : schedule)
+    if (reached[i])
+      plan->schedule.push_back(i);
+  group_levels(plan->schedule, plan->steps);
+
+  const unsigned* origins = net.feedback_register_origins();
+  for (unsigned r = 0; r < net.n_feedback_registers(); r++)
+    if (reached[origins[r]])
+      plan->origins.push_back(origins[r]);
+
+  cached = plan;
+  return cached;
+}
+
+bool concurrent_neural_network::run_sequence(evaluation_context& ctx,
+                                             const std::vector<std::vector<double>>& inputs_sequence,
+                                             std::vector<std::vector<double>>& outputs_sequence) const {
+
+    if (!net.fits(ctx))
+      return false;
+    for (auto& inputs_values : inputs_sequence)
+      if (inputs_values.size() != inputs)
+        return false;
+
+    outputs_sequence.resize(inputs_sequence.size());
+    for (unsigned t = 0; t < inputs_sequence.size(); t++) {
+      step(ctx, inputs_sequence[t]);
+      net.get_outputs(ctx, outputs_sequence[t]);
     }
 
-    // delete unreachable node and find all sucessors
-    if (empty_column) {
-      sucesors.push(j);
-      for (unsigned k = 0; k < size; k++) {
-        if (vec_graph[j][k]) {
-          sucesors.push(j > k ? j - 1 : j);
-          vec_graph[j][k] = 0;
-        }
-      }
-      delete_row_col<bool> (vec_graph, j);
-      delete_row_col<double> (vec_costs, j);
-      size--;
+    return true;
+  }
+
+bool concurrent_neural_network::run_sequences(evaluation_context& ctx,
+                                              const std::vector<std::vector<std::vector<double>>>& inputs_sequences,
+                                              std::vector<std::vector<std::vector<double>>>& outputs_sequences) const {
+
+    if (!net.fits(ctx))
+      return false;
+    unsigned steps = inputs_sequences.empty() ? 0 : inputs_sequences[0].size();
+    for (auto& sequence : inputs_sequences) {
+      if (sequence.size() != steps)
+        return false;
+      for (auto& inputs_values : sequence)
+        if (inputs_values.size() != inputs)
+          return false;
+    }
+
+    outputs_sequences.resize(inputs_sequences.size());
+    for (auto& sequence : outputs_sequences)
+      sequence.resize(steps);
+    if (inputs_sequences.empty())
+      return true;
+
+    net.start_batch_sequences(ctx, inputs_sequences.size());
+    for (unsigned t = 0; t < steps; t++) {
+      net.propagate_batch_feedback(ctx);
+      net.set_batch_step_inputs(ctx, inputs_sequences, t);
+      evaluate(ctx, true);
+      net.get_batch_step_outputs(ctx, outputs_sequences, t);
     }
+
+    return true;
+  }
+
+void concurrent_neural_network::step(evaluation_context& ctx,
+                                     const std::vector<double>& inputs_values) const {
+  if (mode == execution_mode::incremental) {
+    incremental.run(net, ctx, inputs_values, epsilon);
+    return;
   }
+
+  net.propagate_feedback(ctx);
+
+  // Establecer los inputs
+  net.set_inputs(ctx, inputs_values);
+
+  evaluate(ctx, false);
 }
 
+void concurrent_neural_network::evaluate(evaluation_context& ctx, bool batched, bool instrumented) const {
+  if (mode == execution_mode::dataflow) {
+    if (!ctx.dataflow)
+      ctx.dataflow.reset(new dataflow_state());
+    if (batched)
+      dataflow.run(net, *pool, *ctx.dataflow, [&](unsigned i) { net.calculate_neuron_batch(ctx, i); });
+    else
+      dataflow.run(net, *pool, *ctx.dataflow, [&](unsigned i) { net.calculate_neuron(ctx, i); });
+    return;
+  }
 
-void concurrent_neural_network::delete_deathend_nodes(std::vector< std::vector< bool > >& vec_graph,
-                                                      std::vector< std::vector< double > >& vec_costs,
-                                                      unsigned int inputs, unsigned int outputs) {
-  unsigned size = vec_graph.size();
+  run_steps(ctx, batched, schedule, concurrent_steps, instrumented);
+}
 
-  std::stack<unsigned> predecesors;
-  for (unsigned i = size - outputs - 1; i >= inputs; i--)
-    predecesors.push(i);
-
-  unsigned i;
-  while (predecesors.size() != 0) {
-    // find next valid candidate in the stack
-    do {
-      if (predecesors.size() == 0)
-        return;
-      i = predecesors.top();
-      predecesors.pop();
-    } while (i < inputs || i > size - outputs - 1);
-
-    bool empty_row = true;
-    for (unsigned j = i + 1; j < size; j++) {
-      if (vec_graph[i][j]) {
-        empty_row = false;
-        j = size;
-      }
+void concurrent_neural_network::run_steps(evaluation_context& ctx, bool batched,
+                                          const std::vector<unsigned>& order,
+                                          const std::vector<concurrent_step>& steps,
+                                          bool instrumented) const {
+  std::function<void (unsigned, unsigned)> calculate_neurons = [&](unsigned begin, unsigned end) {
+    for (unsigned k = begin; k < end; k++) {
+      if (batched)
+        net.calculate_neuron_batch(ctx, order[k]);
+      else
+        net.calculate_neuron(ctx, order[k]);
     }
-    // delete deathend node and find all predecesors
-    if (empty_row) {
-      predecesors.push(i);
-      for (unsigned k = 0; k < size; k++) {
-        if (vec_graph[k][i]) {
-          predecesors.push(k > i ? k - 1 : k);
-          vec_graph[k][i] = 0;
-        }
-      }
-      delete_row_col<bool> (vec_graph, i);
-      delete_row_col<double> (vec_costs, i);
-      size--;
+  };
+
+  for (unsigned s = 0; s < steps.size(); s++) {
+    const concurrent_step& step = steps[s];
+#ifdef CNN_INSTRUMENTATION
+    if (instrumented) {
+      run_timed_step(s, step, order, calculate_neurons);
+      continue;
+    }
+#else
+    (void) instrumented;
+#endif
+    if (step.parallel) {
+      // chunks of at least parallel_threshold work
+      unsigned n = step.end - step.begin;
+      unsigned grain = std::max<unsigned>(1, (unsigned long long)n * parallel_threshold / step.work);
+      pool->parallel_for(step.begin, step.end, calculate_neurons, grain);
+    } else {
+      calculate_neurons(step.begin, step.end);
     }
   }
 }
 
-std::vector< unsigned int > concurrent_neural_network::generate_visited_nodes(const std::vector< std::vector< bool > >& vec) {
-  unsigned size = vec.size();
-  std::vector<unsigned> visited_nodes (size);
+void concurrent_neural_network::run_timed_step(unsigned index, const concurrent_step& step,
+                                               const std::vector<unsigned>& order,
+                                               const std::function<void (unsigned, unsigned)>& calculate_neurons) const {
+  const unsigned* offsets = net.predecessor_offsets();
+  const unsigned* feedback_offsets = net.feedback_predecessor_offsets();
+
+  uint64_t begin = stats_clock();
+  uint64_t wait = 0;
+  if (step.parallel) {
+    std::atomic<uint64_t> finished (0);
+    std::atomic<unsigned> chunks (0);
+    std::function<void (unsigned, unsigned)> timed = [&](unsigned b, unsigned e) {
+      calculate_neurons(b, e);
+      finished.fetch_add(stats_clock());
+      chunks.fetch_add(1);
+    };
+    unsigned n = step.end - step.begin;
+    unsigned grain = std::max<unsigned>(1, (unsigned long long)n * parallel_threshold / step.work);
+    pool->parallel_for(step.begin, step.end, timed, grain);
+    uint64_t end = stats_clock();
+    wait = chunks.load() * end - finished.load();
+  } else {
+    calculate_neurons(step.begin, step.end);
+  }
+  uint64_t elapsed = stats_clock() - begin;
+
+  unsigned edges = 0;
+  for (unsigned k = step.begin; k < step.end; k++) {
+    unsigned i = order[k];
+    edges += offsets[i + 1] - offsets[i] + feedback_offsets[i + 1] - feedback_offsets[i];
+  }
+  stats->record_step(index, elapsed, wait, step.end - step.begin, edges);
+}
+
+void concurrent_neural_network::instrumented_call(evaluation_context& ctx,
+                                                  const std::vector<double>& inputs_values,
+                                                  std::vector<double>& outputs_values) const {
+  uint64_t begin = stats_clock();
+  uint64_t last = begin;
+  auto phase = [&](network_phase p) {
+    uint64_t now = stats_clock();
+    stats->record_phase(p, now - last);
+    last = now;
+  };
+
+  if (mode == execution_mode::incremental) {
+    incremental.run(net, ctx, inputs_values, epsilon);
+    phase(PHASE_EVALUATE);
+  } else {
+    net.propagate_feedback(ctx);
+    phase(PHASE_FEEDBACK);
+    net.set_inputs(ctx, inputs_values);
+    phase(PHASE_INPUTS);
+    evaluate(ctx, false, true);
+    phase(PHASE_EVALUATE);
+  }
+
+  net.get_outputs(ctx, outputs_values);
+  phase(PHASE_OUTPUTS);
+  stats->record_latency(last - begin);
+}
+
+void concurrent_neural_network::instrumented_batch(evaluation_context& ctx,
+                                                   const std::vector<std::vector<double>>& inputs_batch,
+                                                   std::vector<std::vector<double>>& outputs_batch) const {
+  uint64_t begin = stats_clock();
+  uint64_t last = begin;
+  auto phase = [&](network_phase p) {
+    uint64_t now = stats_clock();
+    stats->record_phase(p, now - last);
+    last = now;
+  };
+
+  net.set_batch_inputs(ctx, inputs_batch);
+  phase(PHASE_INPUTS);
+  evaluate(ctx, true, true);
+  phase(PHASE_EVALUATE);
+  net.get_batch_outputs(ctx, outputs_batch);
+  phase(PHASE_OUTPUTS);
+  stats->record_latency(last - begin);
+}
 
-  for (unsigned i = 0; i < size; i++) {
-    for (unsigned j = i + 1; j < size; j++) {
-      if (vec[i][j])
-        visited_nodes[j]++;
+bool concurrent_neural_network::profile(evaluation_context& ctx,
+                                        const std::vector<double>& inputs_values,
+                                        std::vector<double>& outputs_values,
+                                        const perf_counters& counters,
+                                        perf_report& report) const {
+  if (inputs_values.size() != inputs || !net.fits(ctx))
+    return false;
+
+  const unsigned* offsets = net.predecessor_offsets();
+  const unsigned* feedback_offsets = net.feedback_predecessor_offsets();
+
+  for (unsigned e = 0; e < N_PERF_EVENTS; e++)
+    report.available[e] = counters.available(perf_event_kind(e));
+  report.edges = net.n_edges();
+  report.steps.resize(concurrent_steps.size());
+
+  perf_sample begin;
+  perf_sample step_begin;
+  perf_sample step_end;
+  perf_sample end;
+
+  counters.read(begin);
+  net.propagate_feedback(ctx);
+  net.set_inputs(ctx, inputs_values);
+
+  for (unsigned s = 0; s < concurrent_steps.size(); s++) {
+    const concurrent_step& step = concurrent_steps[s];
+    counters.read(step_begin);
+    for (unsigned k = step.begin; k < step.end; k++)
+      net.calculate_neuron(ctx, schedule[k]);
+    counters.read(step_end);
+
+    perf_step_report& step_report = report.steps[s];
+    step_report.counters = perf_difference(step_end, step_begin);
+    step_report.neurons = step.end - step.begin;
+    step_report.edges = 0;
+    for (unsigned k = step.begin; k < step.end; k++) {
+      unsigned i = schedule[k];
+      step_report.edges += offsets[i + 1] - offsets[i] + feedback_offsets[i + 1] - feedback_offsets[i];
     }
   }
-  return visited_nodes;
+
+  net.get_outputs(ctx, outputs_values);
+  counters.read(end);
+  report.total = perf_difference(end, begin);
+  return true;
 }
 
-std::vector<unsigned int> concurrent_neural_network::generate_concurrent_steps(const std::vector<std::vector<bool>>& vec) {
-  unsigned size = vec.size();
-  std::vector<unsigned> visited_nodes = generate_visited_nodes(vec);
+network_stats concurrent_neural_network::get_stats() const {
+  network_stats snapshot = stats->snapshot();
+#ifndef CNN_INSTRUMENTATION
+  snapshot.enabled = false;
+#endif
+  return snapshot;
+}
 
-  std::vector<unsigned> solve;
+void concurrent_neural_network::set_parallel_threshold(unsigned int work) {
+  parallel_threshold = work;
+  generate_concurrent_steps();
+  plans = std::make_shared<output_plan_cache>();
+  stats->resize(concurrent_steps.size());
+}
 
-  auto aux_visited = visited_nodes;
+namespace {
+
+// forward (upper triangle) adjacency in CSR form, successors and
+// predecessors, so the search touches flat arrays
+struct forward_adjacency {
+  std::vector<unsigned> sucesor_offsets;
+  std::vector<unsigned> sucesors;
+  std::vector<unsigned> predecesor_offsets;
+  std::vector<unsigned> predecesors;
+
+  // edges (from, to) must be given twice in the same order: once to count
+  // and once to fill
+  template <class edge_visitor>
+  forward_adjacency (unsigned size, edge_visitor edges) :
+                     sucesor_offsets(size + 1), predecesor_offsets(size + 1) {
+    edges([&](unsigned i, unsigned j) {
+      sucesor_offsets[i + 1]++;
+      predecesor_offsets[j + 1]++;
+    });
+    for (unsigned i = 0; i < size; i++) {
+      sucesor_offsets[i + 1] += sucesor_offsets[i];
+      predecesor_offsets[i + 1] += predecesor_offsets[i];
+    }
 
-  unsigned last_node = 0;
+    sucesors.resize(sucesor_offsets[size]);
+    predecesors.resize(predecesor_offsets[size]);
+    std::vector<unsigned> sucesor_cursor (sucesor_offsets.begin(), sucesor_offsets.end() - 1);
+    std::vector<unsigned> predecesor_cursor (predecesor_offsets.begin(), predecesor_offsets.end() - 1);
+    edges([&](unsigned i, unsigned j) {
+      sucesors[sucesor_cursor[i]++] = j;
+      predecesors[predecesor_cursor[j]++] = i;
+    });
+  }
 
-  for (unsigned i = 0; i < size; i++) {
-    for (unsigned j = i + 1; j < size; j++) {
-      if (vec[i][j]) {
-        if (visited_nodes[i] != 0) {
-          visited_nodes = aux_visited;
-          solve.push_back(last_node);
+  std::vector<unsigned> useful_nodes (unsigned inputs, unsigned outputs) const {
+    unsigned size = sucesor_offsets.size() - 1;
+    std::vector<unsigned> pending (size);
+    auto search = [&](const std::vector<unsigned>& offsets, const std::vector<unsigned>& adjacency,
+                      unsigned first, unsigned last) {
+      std::vector<bool> reached (size);
+      unsigned top = 0;
+      for (unsigned i = first; i < last; i++) {
+        reached[i] = true;
+        pending[top++] = i;
+      }
+      while (top > 0) {
+        unsigned i = pending[--top];
+        for (unsigned k = offsets[i]; k < offsets[i + 1]; k++) {
+          unsigned j = adjacency[k];
+          if (!reached[j]) {
+            reached[j] = true;
+            pending[top++] = j;
+          }
         }
-        aux_visited[j]--;
-        last_node = i;
       }
+      return reached;
+    };
+
+    std::vector<bool> from_inputs = search(sucesor_offsets, sucesors, 0, inputs);
+    std::vector<bool> to_outputs = search(predecesor_offsets, predecesors, size - outputs, size);
+
+    std::vector<unsigned> alive;
+    for (unsigned i = 0; i < size; i++) {
+      if (i < inputs || i >= size - outputs || (from_inputs[i] && to_outputs[i]))
+        alive.push_back(i);
+    }
+    return alive;
+  }
+};
+
+}
+
+void concurrent_neural_network::reorder_neurons() {
+  std::vector<unsigned> order = net.locality_order();
+  compiled_network permuted;
+  if (!net.permuted(order, permuted))
+    return;
+
+  std::vector<unsigned> position (order.size());
+  for (unsigned k = 0; k < order.size(); k++)
+    position[order[k]] = k;
+  for (unsigned& k : compiled_index)
+    if (k != ~0u)
+      k = position[k];
+
+  bool instrumented = stats->active();
+  net = permuted;
+  reordered = true;
+  build_schedule();
+  stats->set_enabled(instrumented);
+}
+
+network_genome& concurrent_neural_network::mutable_genome() {
+  if (!genome) {
+    genome = std::make_shared<network_genome>(net);
+    compiled_index = network_genome::original_order(net);
+  } else if (genome.use_count() > 1) {
+    genome = std::make_shared<network_genome>(*genome);
+  }
+  return *genome;
+}
+
+void concurrent_neural_network::index_neurons() {
+  compiled_index.assign(genome->size(), ~0u);
+  for (unsigned k = 0; k < net.n_neurons(); k++)
+    compiled_index[net.original_neurons()[k]] = k;
+}
+
+void concurrent_neural_network::recompile() {
+  compiled_network compiled (*genome);
+  compiled.set_tanh_mode(net.get_tanh_mode());
+  compiled.set_kernels(net.kernels());
+
+  compiled_network permuted;
+  if (reordered && compiled.permuted(compiled.locality_order(), permuted))
+    compiled = permuted;
+
+  bool instrumented = stats->active();
+  net = compiled;
+  index_neurons();
+  build_schedule();
+  stats->set_enabled(instrumented);
+}
+
+bool concurrent_neural_network::set_weight(unsigned int from, unsigned int to, double weight) {
+  network_genome& g = mutable_genome();
+  if (!g.set_weight(from, to, weight))
+    return false;
+  if (g.alive(from) && g.alive(to)) {
+    net.set_weight(compiled_index[from], compiled_index[to], weight);
+    context.invalidate();
+  }
+  return true;
+}
+
+bool concurrent_neural_network::add_edge(unsigned int from, unsigned int to, double weight) {
+  network_genome& g = mutable_genome();
+  unsigned changes = g.pruning_changes();
+  if (!g.add_edge(from, to, weight))
+    return false;
+  if (g.pruning_changes() != changes || (g.alive(from) && g.alive(to)))
+    recompile();
+  return true;
+}
+
+bool concurrent_neural_network::remove_edge(unsigned int from, unsigned int to) {
+  network_genome& g = mutable_genome();
+  unsigned changes = g.pruning_changes();
+  bool compiled = g.find(from, to) && g.alive(from) && g.alive(to);
+  if (!g.remove_edge(from, to))
+    return false;
+  if (g.pruning_changes() != changes || compiled)
+    recompile();
+  return true;
+}
+
+bool concurrent_neural_network::split_edge(unsigned int from, unsigned int to, unsigned int& neuron) {
+  network_genome& g = mutable_genome();
+  const genome_connection* connection = g.find(from, to);
+  if (!connection)
+    return false;
+  double weight = connection->weight;
+
+  unsigned first_output = g.size() - outputs;
+  auto hidden = [&](unsigned position) { return position >= inputs && position <= first_output; };
+  unsigned position;
+  if (from < to)
+    position = std::min(to, first_output);
+  else
+    position = hidden(from + 1) ? from + 1 : to;
+  if (!hidden(position) || (from < to && position <= from))
+    return false;
+
+  g.insert_neuron(position, 0);
+  if (from >= position)
+    from++;
+  if (to >= position)
+    to++;
+  g.remove_edge(from, to);
+  g.add_edge(from, position, 1);
+  g.add_edge(position, to, weight);
+
+  neuron = position;
+  recompile();
+  return true;
+}
+
+bool concurrent_neural_network::remove_neuron(unsigned int neuron) {
+  network_genome& g = mutable_genome();
+  if (!g.remove_neuron(neuron))
+    return false;
+  recompile();
+  return true;
+}
+
+void concurrent_neural_network::place_on_node(unsigned int node) {
+  const numa_topology& topology = numa_topology::system();
+  if (node >= topology.n_nodes())
+    return;
+
+  std::shared_ptr<char> buffer = topology.allocate(net.image_size(), node);
+  if (!buffer)
+    return;
+  net.move_image(buffer);
+  topology.run_on(node, [this] {
+    evaluation_context local (context);
+    context = std::move(local);
+  });
+}
+
+std::vector<unsigned> concurrent_neural_network::find_useful_nodes(const std::vector<std::vector<bool>>& vec_graph,
+                                                                   unsigned int inputs, unsigned int outputs) {
+  unsigned size = vec_graph.size();
+  forward_adjacency adjacency (size, [&](std::function<void(unsigned, unsigned)> visit) {
+    for (unsigned i = 0; i < size; i++)
+      for (unsigned j = i + 1; j < size; j++)
+        if (vec_graph[i][j])
+          visit(i, j);
+  });
+  return adjacency.useful_nodes(inputs, outputs);
+}
+
+void concurrent_neural_network::generate_levels() {
+  unsigned size = net.n_neurons();
+  const unsigned* offsets = net.predecessor_offsets();
+  const unsigned* predecessors = net.predecessors();
+
+  // forward connections always go to a higher index, so the index order is
+  // already topological
+  levels.assign(size, 0);
+  for (unsigned j = 0; j < size; j++)
+    for (unsigned k = offsets[j]; k < offsets[j + 1]; k++)
+      levels[j] = std::max(levels[j], levels[predecessors[k]] + 1);
+
+  // counting sort by level, stable by index
+  std::vector<unsigned> first (n_levels() + 1);
+  for (unsigned level : levels)
+    first[level + 1]++;
+  for (unsigned l = 1; l < first.size(); l++)
+    first[l] += first[l - 1];
+
+  schedule.resize(size);
+  for (unsigned i = 0; i < size; i++)
+    schedule[first[levels[i]]++] = i;
+}
+
+void concurrent_neural_network::generate_concurrent_steps() {
+  group_levels(schedule, concurrent_steps);
+}
+
+void concurrent_neural_network::group_levels(const std::vector<unsigned>& order,
+                                             std::vector<concurrent_step>& steps) const {
+  const unsigned* offsets = net.predecessor_offsets();
+  unsigned size = order.size();
+
+  steps.clear();
+  unsigned k = 0;
+  while (k < size) {
+    // one level
+    unsigned level = levels[order[k]];
+    concurrent_step step {k, k, 1, 0, false};
+    while (step.end < size && levels[order[step.end]] == level) {
+      unsigned i = order[step.end];
+      step.work += offsets[i + 1] - offsets[i] + 1;
+      step.end++;
+    }
+    k = step.end;
+
+    step.parallel = step.work >= parallel_threshold;
+
+    if (!step.parallel && !steps.empty() && !steps.back().parallel) {
+      concurrent_step& last = steps.back();
+      last.end = step.end;
+      last.levels++;
+      last.work += step.work;
+    } else {
+      steps.push_back(step);
     }
   }
-  solve.push_back(last_node);
-  solve.push_back(size - 1);
-  return solve;
 }
@@ -19,12 +19,68 @@
 #ifndef CONCURRENT_NEURAL_NETWORK_H
 #define CONCURRENT_NEURAL_NETWORK_H
 
-#include <future>
+#include <algorithm>
+#include <functional>
 #include <map>
+#include <memory>
+#include <mutex>
 #include <stack>
 
-#include "neuron.h"
-#include "feedback_bus.h"
+#include "code_generator.h"
+#include "compiled_network.h"
+#include "dataflow_executor.h"
+#include "incremental_executor.h"
+#include "network_genome.h"
+#include "network_stats.h"
+#include "perf_counters.h"
+#include "thread_pool.h"
+
+/**
+ * @brief How the neurons of an evaluation are scheduled.
+ *
+ * steps calculates each concurrent step in parallel with a barrier between
+ * steps. dataflow calculates each neuron as soon as its predecessors have
+ * finished, see #dataflow_executor. incremental only recalculates the forward
+ * cone of the inputs that changed since the last evaluation, on the calling
+ * thread, see #incremental_executor; batches are calculated as in steps.
+ */
+enum class execution_mode { steps, dataflow, incremental };
+
+/**
+ * @brief Range of #concurrent_neural_network::schedule calculated in one
+ * step. Parallel steps hold one topological level and are split between the
+ * threads of the pool; inline steps hold one or more consecutive cheap levels
+ * and are calculated in order by the calling thread.
+ *
+ */
+struct concurrent_step {
+  unsigned begin;
+  unsigned end;
+  unsigned levels;
+  unsigned work;
+  bool parallel;
+};
+
+/**
+ * @brief Part of the net calculated when only some outputs are requested:
+ * the neurons the requested outputs depend on through forward or feedback
+ * connections, with their own concurrent steps.
+ */
+struct output_plan {
+  std::vector<unsigned> schedule;
+  std::vector<concurrent_step> steps;
+  // feedback origins inside the cone
+  std::vector<unsigned> origins;
+};
+
+/**
+ * @brief Plans already built, by mask of requested outputs. Shared by the
+ * copies of a net and by the threads evaluating it.
+ */
+struct output_plan_cache {
+  std::mutex mutex;
+  std::map<std::vector<bool>, std::shared_ptr<const output_plan>> plans;
+};
 
 /**
  * @todo write docs
@@ -34,112 +90,497 @@ private:
   unsigned inputs;
   unsigned outputs;
 
-  std::vector<axon*> input_axons;
-  std::vector<axon*> output_axons;
-
-  std::vector<neuron*> neurons;
-  std::vector<unsigned> concurrent_steps;
-
-  std::map<unsigned, feedback_bus*> feedbackers;
-
-  void add_feedbacker (unsigned origin_neuron, unsigned destiny_neuron, double w);
-  void propagate_feedback ();
-
-
-  template <class T>
-  void delete_row_col (std::vector<std::vector<T>>& original, unsigned node) {
-    unsigned size = original.size();
-    std::vector<std::vector<T>> aux (size - 1);
-    for (auto& row : aux)
-      row.resize(size - 1);
-
-    // First quadrant (a)
-    for (unsigned i = 0; i < node; i++) {
-      for (unsigned j = 0; j < node; j++) {
-        aux[i][j] = original[i][j];
-      }
-    }
-
-    // Second quadrant (b)
-    for (unsigned i = 0; i < node; i++) {
-      for (unsigned j = node + 1; j < size; j++) {
-        aux[i][j - 1] = original[i][j];
-      }
-    }
-
-    // Third quadrant (c)
-    for (unsigned i = node + 1; i < size; i++) {
-      for (unsigned j = 0; j < node; j++) {
-        aux[i - 1][j] = original[i][j];
-      }
-    }
-
-    // Fourth quadrant (d)
-    for (unsigned i = node + 1; i < size; i++) {
-      for (unsigned j = node + 1; j < size; j++) {
-        aux[i - 1][j - 1] = original[i][j];
-      }
-    }
-
-    original = aux;
-  }
+  compiled_network net;
+
+  // whole net before pruning, shared by the copies until one of them is
+  // mutated. Null for nets built from a compiled one until their first
+  // mutation
+  std::shared_ptr<network_genome> genome;
+  // index in net of every neuron of the genome, ~0 if it was pruned
+  std::vector<unsigned> compiled_index;
+  bool reordered;
+
+  std::vector<unsigned> levels;
+  std::vector<unsigned> schedule;
+  std::vector<concurrent_step> concurrent_steps;
+  unsigned parallel_threshold;
+
+  thread_pool* pool;
+
+  execution_mode mode;
+  dataflow_executor dataflow;
+  incremental_executor incremental;
+  double epsilon;
+
+  std::shared_ptr<output_plan_cache> plans;
+
+  std::shared_ptr<stats_recorder> stats;
 
+  // used by the calls that do not take a context
+  evaluation_context context;
 
   /**
-   * @brief Delete neurons with no predecesors (excluding inputs and outputs)
+   * @brief Calculates every neuron once with the current execution mode
    *
-   * @param vec_graph p_vec_graph:...
-   * @param vec_costs p_vec_costs:...
-   * @param inputs p_inputs:...
-   * @param outputs p_outputs:...
+   * @param batched p_batched: calculate the batch activations instead of the
+   * single sample ones
    */
-  void delete_unreachable_nodes (std::vector<std::vector<bool>>& vec_graph,
-                                 std::vector<std::vector<double>>& vec_costs,
-                                 unsigned inputs, unsigned outputs);
+  void evaluate (evaluation_context& ctx, bool batched, bool instrumented = false) const;
 
+  /**
+   * @brief Calculates the neurons of order grouped in steps, each step in
+   * parallel or inline
+   */
+  void run_steps (evaluation_context& ctx, bool batched, const std::vector<unsigned>& order,
+                  const std::vector<concurrent_step>& steps, bool instrumented = false) const;
 
   /**
-   * @brief Find deathend nodes to delete them and search in cascade new posible
-   * deathend nodes. Inputs and outputs neuron won't be affected
-   *
-   * @param vec p_vec: newral network graph
-   * @param inputs p_inputs: number of input neurons
-   * @param outputs p_outputs: number of output neurons
+   * @brief Same as one iteration of #run_steps, recording the time of the
+   * step and the time each chunk waits at the barrier into #stats
    */
-  void delete_deathend_nodes (std::vector<std::vector<bool>>& vec_graph,
-                              std::vector<std::vector<double>>& vec_costs,
-                              unsigned inputs, unsigned outputs);
+  void run_timed_step (unsigned index, const concurrent_step& step, const std::vector<unsigned>& order,
+                       const std::function<void (unsigned, unsigned)>& calculate_neurons) const;
 
   /**
-   * @brief Extracts the hidden layers of the net and creates a vector of groups
-   * of neurons that can be safely calculated concurrently.
-   *
-   * @param vec p_vec: Cost matriz of the net
-   * @return std::vector< unsigned int > groups of neurons conccurent-safe
+   * @brief Single sample and batch evaluations that record every phase into
+   * #stats, used instead of the plain ones while the instrumentation is on
    */
-  std::vector<unsigned> generate_concurrent_steps (const std::vector<std::vector<bool>>& vec);
+  void instrumented_call (evaluation_context& ctx, const std::vector<double>& inputs_values,
+                          std::vector<double>& outputs_values) const;
+  void instrumented_batch (evaluation_context& ctx, const std::vector<std::vector<double>>& inputs_batch,
+                           std::vector<std::vector<double>>& outputs_batch) const;
 
   /**
-   * @brief Generates a vector containing the number of predecesors of each node
-   * This function is used by #generate_concurrent_steps to which neurons can
-   * be calculated concurrently.
-   *
-   * @param vec p_vec:...
-   * @return std::vector< unsigned int >
+   * @brief Evaluates one timestep of ctx with the current execution mode
+   */
+  void step (evaluation_context& ctx, const std::vector<double>& inputs_values) const;
+
+  /**
+   * @brief Prepares the executors and the concurrent steps of #net
    */
-  std::vector<unsigned> generate_visited_nodes (const std::vector<std::vector<bool>>& vec);
+  void build_schedule ();
 
+  /**
+   * @brief Calculates the topological level of each neuron (longest forward
+   * path from a neuron without predecessors) in O(V+E) and sorts the neurons
+   * by level into #schedule. Feedback connections do not create levels since
+   * they read the previous evaluation.
+   */
+  void generate_levels ();
+
+  /**
+   * @brief Groups the levels into #concurrent_steps. The work of a level is
+   * estimated as the sum of the fan-in plus one of its neurons; levels whose
+   * work is below #parallel_threshold are merged with the adjacent cheap
+   * levels and calculated inline, the rest are dispatched to the pool.
+   */
+  void generate_concurrent_steps ();
+
+  /**
+   * @brief Groups the levels of order, a subsequence of #schedule, as
+   * #generate_concurrent_steps does
+   */
+  void group_levels (const std::vector<unsigned>& order, std::vector<concurrent_step>& steps) const;
+
+  /**
+   * @brief Returns the cached plan of the requested outputs, building it the
+   * first time the mask is seen
+   */
+  std::shared_ptr<const output_plan> find_plan (const std::vector<bool>& requested) const;
+
+  /**
+   * @brief Genome that can be mutated without changing the copies of the
+   * net, created from the compiled net if there was none
+   */
+  network_genome& mutable_genome ();
+
+  /**
+   * @brief Compiles the net again from the genome
+   */
+  void recompile ();
+
+  /**
+   * @brief Fills #compiled_index from the original indices of a net
+   * compiled from the genome
+   */
+  void index_neurons ();
 
 public:
 
+  /**
+   * @brief Finds the neurons that survive the pruning: inputs, outputs and
+   * the hidden neurons that are part of a forward path from an input to an
+   * output, which is the net that remains after deleting unreachable and
+   * deathend neurons in cascade. Runs one reachability pass in each direction
+   * over CSR adjacency arrays. The net is compiled straight from these
+   * indices, the matrices are never compacted.
+   *
+   * @return std::vector< unsigned int > sorted indices of the useful neurons
+   */
+  static std::vector<unsigned> find_useful_nodes (const std::vector<std::vector<bool>>& vec_graph,
+                                                  unsigned inputs, unsigned outputs);
+
+  /**
+   * @param pool p_pool: workers used to calculate each concurrent step. It
+   * can be shared between networks, #thread_pool::shared is used if null
+   */
   concurrent_neural_network(const std::vector<std::vector<bool>>& vec_graph,
                             const std::vector<std::vector<double>>& vec_costs,
-                            unsigned int inps, unsigned int outs);
+                            unsigned int inps, unsigned int outs,
+                            thread_pool* pool = nullptr);
+
+  /**
+   * @brief Builds the net from a sparse description, without ever creating
+   * the adjacency or cost matrices, so memory grows with the connections
+   * instead of the square of the neurons. Equivalent to the dense constructor
+   * with the edges written into the matrices: self connections and
+   * connections out of range are ignored, and when a connection is repeated
+   * the last one is kept.
+   *
+   * @param edges p_edges: connections of the net
+   * @param vec_thresholds p_vec_thresholds: threshold of every neuron
+   */
+  concurrent_neural_network(const std::vector<network_edge>& edges,
+                            const std::vector<double>& vec_thresholds,
+                            unsigned int inps, unsigned int outs,
+                            thread_pool* pool = nullptr);
+
+  /**
+   * @brief Builds the net from an already compiled one, for example one
+   * loaded with #compiled_network::load. The image is shared, not copied.
+   */
+  explicit concurrent_neural_network(const compiled_network& compiled,
+                                     thread_pool* pool = nullptr);
+
+  /**
+   * @brief Copies share the compiled image, the genome and the output plans
+   * until one of them is mutated, and get their own default context (with a
+   * copy of the state) and their own statistics
+   */
+  concurrent_neural_network(const concurrent_neural_network& other);
+  concurrent_neural_network& operator= (const concurrent_neural_network& other);
+
+  concurrent_neural_network(concurrent_neural_network&& other) = default;
+  concurrent_neural_network& operator= (concurrent_neural_network&& other) = default;
+
+  // MUTATIONS --------------------------------------------------------------
+  //
+  // Neurons are given by their index in the matrices or edges the net was
+  // built from, as #compiled_network::original_neurons. Nets built from a
+  // compiled one number them by #network_genome::original_order, the
+  // compiled order before any reordering. The result is the same net
+  // that would be built from the mutated matrices. Only the neurons whose
+  // pruning can change are searched again. A weight is changed in place; a
+  // connection that prunes or revives neurons or joins two neurons that are
+  // alive compiles the net again from the genome, in time proportional to
+  // its size, and keeps the execution settings and the locality order, but
+  // resets the default context and the statistics as a new net would. The
+  // rest of the mutations only touch the genome. A net must not be mutated
+  // while it is evaluated, and its contexts and snapshots do not fit it
+  // after a mutation that compiles it again. A weight changed in place
+  // keeps them, but the incremental mode only recalculates what changed
+  // since the last evaluation: the default context is invalidated and the
+  // rest must be too (see #evaluation_context::invalidate).
+
+  /**
+   * @brief Changes the weight of the connection (from, to), or the threshold
+   * of the neuron if both are the same
+   *
+   * @return bool false if there is no such connection
+   */
+  bool set_weight (unsigned from, unsigned to, double weight);
+
+  /**
+   * @brief Connects two neurons, forward if from is lower than to and
+   * feedback otherwise
+   *
+   * @return bool false if they are already connected, the same or out of
+   * range
+   */
+  bool add_edge (unsigned from, unsigned to, double weight);
+
+  /**
+   * @brief #add_edge for a feedback connection, from must be higher than to
+   */
+  bool add_feedback (unsigned from, unsigned to, double weight) {
+    return from > to && add_edge(from, to, weight);
+  }
+
+  bool remove_edge (unsigned from, unsigned to);
+
+  /**
+   * @brief Replaces the connection (from, to) with a new hidden neuron,
+   * connected from from with weight 1 and to to with the weight of the
+   * connection, and threshold 0. The new neuron is placed right before to
+   * for a forward connection and right after from for a feedback one (so
+   * the delay stays in its second half), or before to if that is not a
+   * hidden position, and the neurons from there on are renumbered.
+   *
+   * @param neuron p_neuron: index of the new neuron
+   * @return bool false if there is no such connection or no hidden position
+   * between both neurons
+   */
+  bool split_edge (unsigned from, unsigned to, unsigned& neuron);
+
+  /**
+   * @brief Removes a hidden neuron and its connections, renumbering the
+   * neurons that follow it
+   */
+  bool remove_neuron (unsigned neuron);
+
+  /**
+   * @brief Pruned and compiled net, for example to build a reduced precision
+   * one from it, see #reduced_precision.h
+   */
+  const compiled_network& compiled () const { return net; }
+
+  /**
+   * @brief Saves the compiled net in the binary format, see #net_io.h
+   */
+  bool save (const std::string& filename) const { return net.save(filename); }
+
+  /**
+   * @brief Writes the C++ source of the net, see #generate_network_source
+   */
+  bool generate_source (const std::string& filename, const std::string& name) const {
+    return write_network_source(net, name, filename);
+  }
 
   bool operator () (const std::vector<double>& inputs_values,
-                    std::vector<double>& outputs_values);
+                    std::vector<double>& outputs_values) {
+    return (*this)(context, inputs_values, outputs_values);
+  }
+
+  /**
+   * @brief Evaluates a batch of samples in one pass, one row per sample. Each
+   * sample sees the feedback of the last single evaluation, the recurrent
+   * state of the net is not modified.
+   *
+   * @param inputs_batch p_inputs_batch: N x inputs matrix
+   * @param outputs_batch p_outputs_batch: N x outputs matrix
+   * @return bool false if any row has not the right number of inputs
+   */
+  bool operator () (const std::vector<std::vector<double>>& inputs_batch,
+                    std::vector<std::vector<double>>& outputs_batch) {
+    return (*this)(context, inputs_batch, outputs_batch);
+  }
+
+  /**
+   * @brief Same as the calls above, but all the state is read from and
+   * written to ctx. The net itself is not modified, so many threads can
+   * evaluate it at the same time with a context each. Every call that takes
+   * a context returns false, without touching it, if ctx does not fit the
+   * net (see #compiled_network::fits).
+   */
+  bool operator () (evaluation_context& ctx,
+                    const std::vector<double>& inputs_values,
+                    std::vector<double>& outputs_values) const;
+
+  bool operator () (evaluation_context& ctx,
+                    const std::vector<std::vector<double>>& inputs_batch,
+                    std::vector<std::vector<double>>& outputs_batch) const;
+
+  /**
+   * @brief Evaluates only the neurons the requested outputs depend on (the
+   * backward cone of the outputs through forward and feedback connections)
+   * and fills only those outputs, the rest are set to 0. The cone of each
+   * mask is found once and cached. Always uses the concurrent steps.
+   *
+   * Neurons outside the cone keep the value of the last evaluation that
+   * calculated them, which is the feedback a later evaluation that needs
+   * them will read.
+   *
+   * @param requested p_requested: one flag per output
+   * @return bool false if the mask or the inputs have not the right size
+   */
+  bool operator () (const std::vector<bool>& requested,
+                    const std::vector<double>& inputs_values,
+                    std::vector<double>& outputs_values) {
+    return (*this)(context, requested, inputs_values, outputs_values);
+  }
+
+  bool operator () (evaluation_context& ctx,
+                    const std::vector<bool>& requested,
+                    const std::vector<double>& inputs_values,
+                    std::vector<double>& outputs_values) const;
+
+  /**
+   * @brief Runs a sequence of T timesteps, the same as T single calls. The
+   * feedback of each timestep reads the activations of the previous one.
+   *
+   * @param inputs_sequence p_inputs_sequence: T x inputs matrix
+   * @param outputs_sequence p_outputs_sequence: T x outputs matrix
+   * @return bool false if any row has not the right number of inputs
+   */
+  bool run_sequence (const std::vector<std::vector<double>>& inputs_sequence,
+                     std::vector<std::vector<double>>& outputs_sequence) {
+    return run_sequence(context, inputs_sequence, outputs_sequence);
+  }
+
+  bool run_sequence (evaluation_context& ctx,
+                     const std::vector<std::vector<double>>& inputs_sequence,
+                     std::vector<std::vector<double>>& outputs_sequence) const;
+
+  /**
+   * @brief Runs a batch of independent sequences of the same length in one
+   * pass per timestep. Each sequence starts from the recurrent state of ctx
+   * and keeps its own state between timesteps; ctx is not modified.
+   *
+   * @param inputs_sequences p_inputs_sequences: sequences x T x inputs
+   * @param outputs_sequences p_outputs_sequences: sequences x T x outputs
+   * @return bool false if the sequences have different lengths or any row
+   * has not the right number of inputs
+   */
+  bool run_sequences (const std::vector<std::vector<std::vector<double>>>& inputs_sequences,
+                      std::vector<std::vector<std::vector<double>>>& outputs_sequences) {
+    return run_sequences(context, inputs_sequences, outputs_sequences);
+  }
+
+  bool run_sequences (evaluation_context& ctx,
+                      const std::vector<std::vector<std::vector<double>>>& inputs_sequences,
+                      std::vector<std::vector<std::vector<double>>>& outputs_sequences) const;
+
+  /**
+   * @brief New context for this net, with the recurrent state set to 0
+   */
+  evaluation_context create_context () const { return evaluation_context(net); }
+
+  /**
+   * @brief Captures the recurrent state of ctx into a compact buffer, one
+   * value per neuron with feedback connections. Empty if ctx does not fit
+   * the net.
+   */
+  std::vector<double> snapshot (const evaluation_context& ctx) const {
+    std::vector<double> state;
+    if (net.fits(ctx))
+      net.capture_state(ctx, state);
+    return state;
+  }
+
+  std::vector<double> snapshot () const { return snapshot(context); }
+
+  /**
+   * @brief Sets the recurrent state of ctx from a #snapshot
+   *
+   * @return bool false if the snapshot was not taken from this net
+   */
+  bool restore (evaluation_context& ctx, const std::vector<double>& state) const {
+    return net.restore_state(ctx, state);
+  }
+
+  bool restore (const std::vector<double>& state) { return restore(context, state); }
+
+  /**
+   * @brief New branch of the net that continues from a #snapshot. Only the
+   * state is allocated, the topology and the schedule are shared with this
+   * net.
+   *
+   * @param branch p_branch: context of the new branch
+   * @return bool false, leaving branch untouched, if the snapshot was not
+   * taken from this net
+   */
+  bool fork (const std::vector<double>& state, evaluation_context& branch) const {
+    evaluation_context forked (net);
+    if (!net.restore_state(forked, state))
+      return false;
+    branch = std::move(forked);
+    return true;
+  }
+
+  /**
+   * @brief Context used by the calls that do not take one
+   */
+  evaluation_context& default_context () { return context; }
+
+  unsigned c_steps () const { return concurrent_steps.size(); }
+
+  /**
+   * @brief Steps calculated in each evaluation, with the levels they hold and
+   * their estimated work
+   */
+  const std::vector<concurrent_step>& get_concurrent_steps () const { return concurrent_steps; }
+
+  unsigned n_levels () const { return levels.empty() ? 0 : *std::max_element(levels.begin(), levels.end()) + 1; }
+
+  /**
+   * @brief Minimum estimated work (edges plus neurons) of a level to be
+   * dispatched to the pool instead of calculated by the caller
+   */
+  void set_parallel_threshold (unsigned work);
+
+  /**
+   * @brief Renumbers the hidden neurons with
+   * #compiled_network::locality_order, so each concurrent step reads and
+   * writes activations that are mostly contiguous. Meant to be called right
+   * after building the net: the results do not change, but the default
+   * context is reset and the contexts and snapshots taken before do not fit
+   * the new numbering. Inputs and outputs keep their indices, and
+   * #compiled_network::original_neurons maps the new indices back to the
+   * matrices.
+   */
+  void reorder_neurons ();
+
+  /**
+   * @brief Moves the compiled net and the default context to the memory of
+   * a node of #numa_topology::system, so the workers of that node read them
+   * locally. The pool is not changed: give the net one pinned to the CPUs of
+   * the node (see #thread_pool) and evaluate it from there. Contexts created
+   * later are placed by the thread that creates them.
+   */
+  void place_on_node (unsigned node);
+
+  /**
+   * @brief Selects std::tanh (default) or its fast approximation, see
+   * #tanh_mode for the error bound
+   */
+  void set_tanh_mode (tanh_mode mode) { net.set_tanh_mode(mode); }
+
+  /**
+   * @brief Overrides the vector kernels detected at runtime, mostly to
+   * compare them against the scalar ones
+   */
+  void set_kernels (const kernel_set& kernels) { net.set_kernels(kernels); }
+
+  void set_execution_mode (execution_mode m) { mode = m; }
+
+  /**
+   * @brief Starts or stops recording the time of every phase and concurrent
+   * step of the single sample and batch evaluations, see #stats_recorder.
+   * Has no effect unless built with CNN_INSTRUMENTATION.
+   */
+  void set_instrumentation (bool enabled) { stats->set_enabled(enabled); }
+
+  /**
+   * @brief Snapshot of the counters recorded since the net was built, the
+   * concurrent steps changed or #reset_stats was called
+   */
+  network_stats get_stats () const;
+
+  void reset_stats () { stats->reset(); }
+
+  /**
+   * @brief Evaluates one sample as the single sample call does, but
+   * calculates every concurrent step on the calling thread and reads the
+   * hardware counters around the whole evaluation and around each step.
+   * The counters must have been built by the calling thread; if none of
+   * them is available the evaluation still runs and the report is all 0.
+   *
+   * @return bool false if the inputs have not the right size
+   */
+  bool profile (evaluation_context& ctx,
+                const std::vector<double>& inputs_values,
+                std::vector<double>& outputs_values,
+                const perf_counters& counters,
+                perf_report& report) const;
+
+  /**
+   * @brief Minimum change of a neuron to propagate it in the incremental
+   * mode. With 0 (default) the results are exactly the ones of a full
+   * evaluation.
+   */
+  void set_incremental_epsilon (double e) { epsilon = e; }
 
-  unsigned c_steps () { return concurrent_steps.size(); }
+  void set_thread_pool (thread_pool* p) { pool = (p != nullptr) ? p : &thread_pool::shared(); }
 
 };
 
@@ -0,0 +1,110 @@
+/*
+ * <one line to give the program's name and a brief idea of what it does.>
+ * Copyright (C) 2018  Daniel Darias Sánchez <dariasteam94@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <thread>
+
+#include "dataflow_executor.h"
+
+void dataflow_executor::bind(const compiled_network& net) {
+  roots.clear();
+  const unsigned* offsets = net.predecessor_offsets();
+  for (unsigned i = 0; i < net.n_neurons(); i++)
+    if (offsets[i] == offsets[i + 1])
+      roots.push_back(i);
+}
+
+void dataflow_executor::push(dataflow_state& state, unsigned participant, unsigned neuron) const {
+  work_deque& own = *state.deques[participant];
+  std::lock_guard<std::mutex> lock (own.mutex);
+  own.items.push_back(neuron);
+}
+
+bool dataflow_executor::pop(dataflow_state& state, unsigned participant, unsigned& neuron) const {
+  work_deque& own = *state.deques[participant];
+  std::lock_guard<std::mutex> lock (own.mutex);
+  if (own.items.empty())
+    return false;
+  neuron = own.items.back();
+  own.items.pop_back();
+  return true;
+}
+
+bool dataflow_executor::steal(dataflow_state& state, unsigned participant, unsigned& neuron) const {
+  unsigned n = state.deques.size();
+  for (unsigned k = 1; k < n; k++) {
+    work_deque& victim = *state.deques[(participant + k) % n];
+    std::lock_guard<std::mutex> lock (victim.mutex);
+    if (!victim.items.empty()) {
+      neuron = victim.items.front();
+      victim.items.pop_front();
+      return true;
+    }
+  }
+  return false;
+}
+
+void dataflow_executor::work(const compiled_network& net, dataflow_state& state, unsigned participant,
+                             const std::function<void (unsigned)>& calculate) const {
+  const unsigned* offsets = net.sucessor_offsets();
+  const unsigned* targets = net.sucessors();
+
+  unsigned neuron;
+  while (state.remaining.load() != 0) {
+    if (!pop(state, participant, neuron) && !steal(state, participant, neuron)) {
+      std::this_thread::yield();
+      continue;
+    }
+
+    calculate(neuron);
+
+    for (unsigned k = offsets[neuron]; k < offsets[neuron + 1]; k++)
+      if (state.pending[targets[k]].fetch_sub(1) == 1)
+        push(state, participant, targets[k]);
+
+    state.remaining.fetch_sub(1);
+  }
+}
+
+void dataflow_executor::run(const compiled_network& net, thread_pool& pool, dataflow_state& state,
+                            const std::function<void (unsigned)>& calculate) const {
+  unsigned size = net.n_neurons();
+  if (size == 0)
+    return;
+
+  if (state.size != size) {
+    state.pending.reset(new std::atomic<unsigned>[size]);
+    state.size = size;
+  }
+
+  unsigned participants = pool.size() + 1;
+  while (state.deques.size() < participants)
+    state.deques.emplace_back(new work_deque());
+
+  const unsigned* offsets = net.predecessor_offsets();
+  for (unsigned i = 0; i < size; i++)
+    state.pending[i].store(offsets[i + 1] - offsets[i]);
+  state.remaining.store(size);
+
+  for (unsigned k = 0; k < roots.size(); k++)
+    state.deques[k % participants]->items.push_back(roots[k]);
+
+  pool.parallel_for(0, participants, [&](unsigned begin, unsigned end) {
+    for (unsigned participant = begin; participant < end; participant++)
+      work(net, state, participant, calculate);
+  });
+}
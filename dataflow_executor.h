@@ -0,0 +1,86 @@
+/*
+ * <one line to give the program's name and a brief idea of what it does.>
+ * Copyright (C) 2018  Daniel Darias Sánchez <dariasteam94@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef DATAFLOW_EXECUTOR_H
+#define DATAFLOW_EXECUTOR_H
+
+#include <atomic>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include "compiled_network.h"
+#include "thread_pool.h"
+
+struct work_deque {
+  std::mutex mutex;
+  std::deque<unsigned> items;
+};
+
+/**
+ * @brief Counters and deques of one dataflow evaluation, kept in the
+ * #evaluation_context so the same net can be evaluated concurrently
+ */
+struct dataflow_state {
+  unsigned size;
+  std::unique_ptr<std::atomic<unsigned>[]> pending;
+  std::atomic<unsigned> remaining;
+  std::vector<std::unique_ptr<work_deque>> deques;
+
+  dataflow_state () : size(0), remaining(0) {}
+};
+
+/**
+ * @brief Alternative to the concurrent steps with no barriers. Every neuron
+ * keeps an atomic counter of forward predecessors not calculated yet and
+ * becomes ready as soon as the last one finishes. Ready neurons are pushed
+ * to the deque of the thread that released them; idle threads steal from
+ * the front of the other deques.
+ *
+ */
+class dataflow_executor {
+private:
+  std::vector<unsigned> roots;
+
+  bool pop (dataflow_state& state, unsigned participant, unsigned& neuron) const;
+  bool steal (dataflow_state& state, unsigned participant, unsigned& neuron) const;
+  void push (dataflow_state& state, unsigned participant, unsigned neuron) const;
+
+  void work (const compiled_network& net, dataflow_state& state, unsigned participant,
+             const std::function<void (unsigned)>& calculate) const;
+
+public:
+  /**
+   * @brief Finds the neurons with no forward predecessors of the net
+   */
+  void bind (const compiled_network& net);
+
+  /**
+   * @brief Calculates every neuron of the net once, respecting the forward
+   * dependencies, with all the threads of the pool plus the caller.
+   *
+   * @param state p_state: scratch counters, resized if needed
+   * @param calculate p_calculate: calculates one neuron
+   */
+  void run (const compiled_network& net, thread_pool& pool, dataflow_state& state,
+            const std::function<void (unsigned)>& calculate) const;
+};
+
+#endif // DATAFLOW_EXECUTOR_H
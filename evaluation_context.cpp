@@ -0,0 +1,61 @@
+/*
+ * <one line to give the program's name and a brief idea of what it does.>
+ * Copyright (C) 2018  Daniel Darias Sánchez <dariasteam94@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "evaluation_context.h"
+#include "compiled_network.h"
+#include "dataflow_executor.h"
+#include "incremental_executor.h"
+
+evaluation_context::evaluation_context() : batch(0), batch_sequences(false),
+                                           history(activation_history::none) {}
+
+evaluation_context::evaluation_context(const compiled_network& net) :
+                                       activations(net.n_neurons(), 0),
+                                       previous(net.n_neurons(), 0),
+                                       external(net.n_inputs(), 0),
+                                       batch(0),
+                                       batch_sequences(false),
+                                       history(activation_history::none) {}
+
+evaluation_context::evaluation_context(const evaluation_context& other) :
+                                       activations(other.activations),
+                                       previous(other.previous),
+                                       external(other.external),
+                                       batch(0),
+                                       batch_sequences(false),
+                                       history(other.history),
+                                       changed_origins(other.changed_origins) {}
+
+evaluation_context& evaluation_context::operator=(const evaluation_context& other) {
+  activations = other.activations;
+  previous = other.previous;
+  external = other.external;
+  history = other.history;
+  changed_origins = other.changed_origins;
+  return *this;
+}
+
+evaluation_context::evaluation_context(evaluation_context&& other) = default;
+evaluation_context& evaluation_context::operator=(evaluation_context&& other) = default;
+evaluation_context::~evaluation_context() = default;
+
+void evaluation_context::reset() {
+  std::fill(activations.begin(), activations.end(), 0);
+  std::fill(previous.begin(), previous.end(), 0);
+  history = activation_history::none;
+}
@@ -0,0 +1,104 @@
+/*
+ * <one line to give the program's name and a brief idea of what it does.>
+ * Copyright (C) 2018  Daniel Darias Sánchez <dariasteam94@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef EVALUATION_CONTEXT_H
+#define EVALUATION_CONTEXT_H
+
+#include <memory>
+#include <vector>
+
+class compiled_network;
+struct dataflow_state;
+struct incremental_state;
+
+/**
+ * @brief How the activations of a context were calculated last. none means
+ * they do not come from an evaluation (new, reset or restored context); full
+ * means every neuron was calculated and previous holds the evaluation before;
+ * incremental means only the dirty neurons were, see #incremental_executor.
+ */
+enum class activation_history { none, full, incremental };
+
+/**
+ * @brief Everything an evaluation writes: the activations of the current and
+ * the previous timestep (the recurrent state) and the batch buffers. A compiled net is
+ * never modified while evaluating, so any number of threads can evaluate the
+ * same net at once as long as each one uses its own context.
+ *
+ * Copying a context copies the recurrent state; the scratch buffers of the
+ * executors are not copied.
+ *
+ */
+class evaluation_context {
+private:
+  std::vector<double> activations;
+  std::vector<double> previous;
+  std::vector<double> external;
+
+  unsigned batch;
+  bool batch_sequences;
+  std::vector<double> batch_activations;
+  std::vector<double> batch_previous;
+  std::vector<double> batch_external;
+
+  activation_history history;
+  // feedback origins changed by the last incremental evaluation
+  std::vector<unsigned> changed_origins;
+
+  // counters and deques of the dataflow mode, created on first use
+  std::unique_ptr<dataflow_state> dataflow;
+  // heap of the incremental mode, created on first use
+  std::unique_ptr<incremental_state> incremental;
+
+  friend class compiled_network;
+  friend class concurrent_neural_network;
+  friend class incremental_executor;
+
+public:
+  evaluation_context ();
+
+  /**
+   * @brief Context for the given net, with all the state set to 0
+   */
+  explicit evaluation_context (const compiled_network& net);
+
+  evaluation_context (const evaluation_context& other);
+  evaluation_context& operator= (const evaluation_context& other);
+  evaluation_context (evaluation_context&& other);
+  evaluation_context& operator= (evaluation_context&& other);
+  ~evaluation_context ();
+
+  /**
+   * @brief Value of a neuron in the last evaluation
+   */
+  double value (unsigned neuron) const { return activations[neuron]; }
+
+  /**
+   * @brief Forgets the recurrent state, as if the net was just built
+   */
+  void reset ();
+
+  /**
+   * @brief Keeps the recurrent state but makes the next incremental
+   * evaluation calculate every neuron instead of the dirty cone. Needed
+   * when the weights of the net change between two evaluations.
+   */
+  void invalidate () { history = activation_history::none; }
+};
+
+#endif // EVALUATION_CONTEXT_H
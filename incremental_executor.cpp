@@ -0,0 +1,126 @@
+/*
+ * <one line to give the program's name and a brief idea of what it does.>
+ * Copyright (C) 2018  Daniel Darias Sánchez <dariasteam94@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <algorithm>
+#include <cmath>
+#include <functional>
+
+#include "incremental_executor.h"
+
+void incremental_executor::bind(const compiled_network& net) {
+  unsigned size = net.n_neurons();
+  const unsigned* offsets = net.feedback_predecessor_offsets();
+  const unsigned* sources = net.feedback_predecessors();
+
+  feedback_out_offsets.assign(size + 1, 0);
+  for (unsigned k = 0; k < net.n_feedback_edges(); k++)
+    feedback_out_offsets[sources[k] + 1]++;
+  for (unsigned i = 0; i < size; i++)
+    feedback_out_offsets[i + 1] += feedback_out_offsets[i];
+
+  feedback_targets.resize(net.n_feedback_edges());
+  std::vector<unsigned> filled (feedback_out_offsets.begin(), feedback_out_offsets.end() - 1);
+  for (unsigned j = 0; j < size; j++)
+    for (unsigned k = offsets[j]; k < offsets[j + 1]; k++)
+      feedback_targets[filled[sources[k]]++] = j;
+}
+
+unsigned incremental_executor::run(const compiled_network& net, evaluation_context& context,
+                                   const std::vector<double>& inputs_values, double epsilon) const {
+  unsigned size = net.n_neurons();
+  const unsigned* origins = net.feedback_register_origins();
+  double* activations = context.activations.data();
+
+  auto differs = [epsilon](double value, double old) {
+    return (epsilon > 0) ? std::abs(value - old) > epsilon : value != old;
+  };
+
+  // EVERYTHING IS DIRTY ----------------------------------------------------
+
+  if (context.history == activation_history::none) {
+    net.set_inputs(context, inputs_values);
+    for (unsigned i = 0; i < size; i++)
+      activations[i] = net.neuron_value(context, i, activations);
+    context.changed_origins.assign(origins, origins + net.n_feedback_registers());
+    context.history = activation_history::incremental;
+    return size;
+  }
+
+  // FEEDBACK THAT CHANGED IN THE LAST EVALUATION ---------------------------
+
+  if (context.history == activation_history::full) {
+    context.changed_origins.clear();
+    for (unsigned r = 0; r < net.n_feedback_registers(); r++)
+      if (differs(activations[origins[r]], context.previous[origins[r]]))
+        context.changed_origins.push_back(origins[r]);
+  }
+
+  if (!context.incremental)
+    context.incremental.reset(new incremental_state());
+  incremental_state& state = *context.incremental;
+  state.queued.resize(size);
+  state.heap.clear();
+
+  auto push = [&](unsigned i) {
+    if (!state.queued[i]) {
+      state.queued[i] = true;
+      state.heap.push_back(i);
+      std::push_heap(state.heap.begin(), state.heap.end(), std::greater<unsigned>());
+    }
+  };
+
+  // SEEDS ------------------------------------------------------------------
+
+  for (unsigned i = 0; i < net.n_inputs(); i++) {
+    if (inputs_values[i] != context.external[i]) {
+      context.external[i] = inputs_values[i];
+      push(i);
+    }
+  }
+  for (unsigned origin : context.changed_origins)
+    for (unsigned k = feedback_out_offsets[origin]; k < feedback_out_offsets[origin + 1]; k++)
+      push(feedback_targets[k]);
+  context.changed_origins.clear();
+
+  // PROPAGATE IN INDEX ORDER -----------------------------------------------
+
+  const unsigned* out_offsets = net.sucessor_offsets();
+  const unsigned* targets = net.sucessors();
+  unsigned calculated = 0;
+
+  while (!state.heap.empty()) {
+    std::pop_heap(state.heap.begin(), state.heap.end(), std::greater<unsigned>());
+    unsigned i = state.heap.back();
+    state.heap.pop_back();
+    state.queued[i] = false;
+    calculated++;
+
+    double value = net.neuron_value(context, i, activations);
+    if (!differs(value, activations[i]))
+      continue;
+
+    activations[i] = value;
+    for (unsigned k = out_offsets[i]; k < out_offsets[i + 1]; k++)
+      push(targets[k]);
+    if (feedback_out_offsets[i] != feedback_out_offsets[i + 1])
+      context.changed_origins.push_back(i);
+  }
+
+  context.history = activation_history::incremental;
+  return calculated;
+}
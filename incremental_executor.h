@@ -0,0 +1,77 @@
+/*
+ * <one line to give the program's name and a brief idea of what it does.>
+ * Copyright (C) 2018  Daniel Darias Sánchez <dariasteam94@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef INCREMENTAL_EXECUTOR_H
+#define INCREMENTAL_EXECUTOR_H
+
+#include <vector>
+
+#include "compiled_network.h"
+
+/**
+ * @brief Scratch of one incremental evaluation, kept in the
+ * #evaluation_context like the #dataflow_state
+ */
+struct incremental_state {
+  // min-heap of the neurons to calculate, so they are popped in index order
+  std::vector<unsigned> heap;
+  std::vector<bool> queued;
+};
+
+/**
+ * @brief Recalculates only the neurons whose value can differ from the last
+ * evaluation. The seeds are the input neurons whose input changed and the
+ * feedback destinations of the neurons that changed in the last evaluation;
+ * every neuron whose value changes pushes its forward sucessors. Neurons are
+ * calculated in index order, which is topological, on the calling thread.
+ *
+ * Feedback connections go to a lower index, so when a neuron is calculated
+ * its feedback origins still hold the value of the last evaluation and they
+ * are read from the activations directly.
+ *
+ * With epsilon 0 a neuron only propagates when its value is not exactly the
+ * same, so the result is identical to a full evaluation. A positive epsilon
+ * keeps the old value (and stops the propagation) of the neurons that change
+ * by less than epsilon.
+ *
+ */
+class incremental_executor {
+private:
+  // feedback sucessors (destinations) of each neuron
+  std::vector<unsigned> feedback_out_offsets;
+  std::vector<unsigned> feedback_targets;
+
+public:
+  /**
+   * @brief Builds the feedback sucessors of the net
+   */
+  void bind (const compiled_network& net);
+
+  /**
+   * @brief Evaluates the net for the given inputs, starting from the
+   * activations of the last evaluation of the context. Falls back to
+   * calculating every neuron when the context has not been evaluated since
+   * it was created, reset or restored.
+   *
+   * @return unsigned number of neurons calculated
+   */
+  unsigned run (const compiled_network& net, evaluation_context& context,
+                const std::vector<double>& inputs_values, double epsilon) const;
+};
+
+#endif // INCREMENTAL_EXECUTOR_H
@@ -0,0 +1,296 @@
+/*
+ * <one line to give the program's name and a brief idea of what it does.>
+ * Copyright (C) 2018  Daniel Darias Sánchez <dariasteam94@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include "inference_service.h"
+
+// largest message accepted from a socket, in doubles
+static const uint32_t max_message = 1 << 20;
+
+static bool read_all(int fd, void* data, size_t length) {
+  char* bytes = static_cast<char*>(data);
+  while (length > 0) {
+    ssize_t n = ::recv(fd, bytes, length, 0);
+    if (n < 0 && errno == EINTR)
+      continue;
+    if (n <= 0)
+      return false;
+    bytes += n;
+    length -= n;
+  }
+  return true;
+}
+
+static bool write_all(int fd, const void* data, size_t length) {
+  const char* bytes = static_cast<const char*>(data);
+  while (length > 0) {
+    ssize_t n = ::send(fd, bytes, length, MSG_NOSIGNAL);
+    if (n < 0 && errno == EINTR)
+      continue;
+    if (n <= 0)
+      return false;
+    bytes += n;
+    length -= n;
+  }
+  return true;
+}
+
+static bool read_message(int fd, std::vector<double>& values) {
+  uint32_t count;
+  if (!read_all(fd, &count, sizeof(count)) || count > max_message)
+    return false;
+  values.resize(count);
+  return read_all(fd, values.data(), count * sizeof(double));
+}
+
+static bool write_message(int fd, const std::vector<double>& values) {
+  uint32_t count = values.size();
+  return write_all(fd, &count, sizeof(count)) &&
+         write_all(fd, values.data(), count * sizeof(double));
+}
+
+static bool unix_address(const std::string& path, sockaddr_un& address) {
+  std::memset(&address, 0, sizeof(address));
+  address.sun_family = AF_UNIX;
+  if (path.empty() || path.size() >= sizeof(address.sun_path))
+    return false;
+  std::memcpy(address.sun_path, path.c_str(), path.size());
+  return true;
+}
+
+inference_service::inference_service(const concurrent_neural_network& n, unsigned b,
+                                     std::chrono::microseconds w) :
+                                     net(n),
+                                     max_batch(std::max(1u, b)),
+                                     max_wait(w),
+                                     context(n.create_context()),
+                                     stopping(false),
+                                     arrival_interval(std::chrono::duration<double>(w).count()),
+                                     last_arrival(clock::now()),
+                                     stats {0, 0, 0},
+                                     listener(-1) {
+  dispatcher = std::thread(&inference_service::dispatch, this);
+}
+
+inference_service::~inference_service() {
+  stop_listening();
+  {
+    std::lock_guard<std::mutex> lock (mutex);
+    stopping = true;
+  }
+  pending.notify_all();
+  dispatcher.join();
+}
+
+std::future<std::vector<double>> inference_service::submit(std::vector<double> inputs) {
+  request r;
+  r.inputs.swap(inputs);
+  r.arrival = clock::now();
+  std::future<std::vector<double>> result = r.result.get_future();
+
+  if (r.inputs.size() != net.compiled().n_inputs()) {
+    r.result.set_value(std::vector<double>());
+    return result;
+  }
+
+  {
+    std::lock_guard<std::mutex> lock (mutex);
+    if (stopping) {
+      r.result.set_value(std::vector<double>());
+      return result;
+    }
+    double interval = std::chrono::duration<double>(r.arrival - last_arrival).count();
+    arrival_interval = 0.875 * arrival_interval + 0.125 * std::min(interval, 1.0);
+    last_arrival = r.arrival;
+    queue.push_back(std::move(r));
+  }
+  pending.notify_one();
+  return result;
+}
+
+bool inference_service::restore(const std::vector<double>& state) {
+  std::lock_guard<std::mutex> lock (context_mutex);
+  return net.compiled().restore_state(context, state);
+}
+
+inference_stats inference_service::get_stats() {
+  std::lock_guard<std::mutex> lock (mutex);
+  return stats;
+}
+
+void inference_service::dispatch() {
+  std::vector<request> batch;
+  while (true) {
+    {
+      std::unique_lock<std::mutex> lock (mutex);
+      pending.wait(lock, [this] { return stopping || !queue.empty(); });
+      if (queue.empty())
+        return;
+
+      // wait for the batch to fill while more requests are expected before
+      // the oldest one runs out of time, and until the burst is over: no
+      // arrival for several times the mean interval
+      clock::time_point deadline = queue.front().arrival + max_wait;
+      while (!stopping && queue.size() < max_batch) {
+        clock::time_point now = clock::now();
+        clock::time_point quiet = last_arrival +
+          std::chrono::duration_cast<clock::duration>(std::chrono::duration<double>(4 * arrival_interval));
+        double left = std::chrono::duration<double>(deadline - now).count();
+        if (left <= 0 || arrival_interval > left || now >= quiet)
+          break;
+        pending.wait_until(lock, std::min(deadline, quiet));
+      }
+
+      unsigned n = std::min<size_t>(queue.size(), max_batch);
+      for (unsigned k = 0; k < n; k++) {
+        batch.push_back(std::move(queue.front()));
+        queue.pop_front();
+      }
+      stats.requests += n;
+      stats.batches++;
+      stats.largest_batch = std::max(stats.largest_batch, n);
+    }
+
+    evaluate(batch);
+    batch.clear();
+  }
+}
+
+void inference_service::evaluate(std::vector<request>& batch) {
+  std::vector<std::vector<double>> inputs_batch (batch.size());
+  std::vector<std::vector<double>> outputs_batch;
+  for (unsigned k = 0; k < batch.size(); k++)
+    inputs_batch[k].swap(batch[k].inputs);
+
+  bool evaluated;
+  {
+    std::lock_guard<std::mutex> lock (context_mutex);
+    evaluated = net(context, inputs_batch, outputs_batch);
+  }
+
+  for (unsigned k = 0; k < batch.size(); k++)
+    batch[k].result.set_value(evaluated ? std::move(outputs_batch[k]) : std::vector<double>());
+}
+
+// SOCKET LISTENER ------------------------------------------------------------
+
+bool inference_service::listen(const std::string& path) {
+  sockaddr_un address;
+  if (listener >= 0 || !unix_address(path, address))
+    return false;
+
+  int fd = ::socket(AF_UNIX, SOCK_STREAM, 0);
+  if (fd < 0)
+    return false;
+  ::unlink(path.c_str());
+  if (::bind(fd, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0 ||
+      ::listen(fd, 64) != 0) {
+    ::close(fd);
+    return false;
+  }
+
+  listener = fd;
+  socket_path = path;
+  acceptor = std::thread(&inference_service::accept_connections, this);
+  return true;
+}
+
+void inference_service::stop_listening() {
+  if (listener < 0)
+    return;
+
+  // shutdown wakes up the threads blocked in accept and recv
+  ::shutdown(listener, SHUT_RDWR);
+  acceptor.join();
+  ::close(listener);
+  ::unlink(socket_path.c_str());
+  listener = -1;
+
+  std::unique_lock<std::mutex> lock (connections_mutex);
+  for (int fd : connections)
+    ::shutdown(fd, SHUT_RDWR);
+  connections_closed.wait(lock, [this] { return connections.empty(); });
+}
+
+void inference_service::accept_connections() {
+  while (true) {
+    int fd = ::accept(listener, nullptr, nullptr);
+    if (fd < 0) {
+      if (errno == EINTR || errno == ECONNABORTED)
+        continue;
+      return;
+    }
+
+    std::lock_guard<std::mutex> lock (connections_mutex);
+    connections.push_back(fd);
+    std::thread(&inference_service::serve, this, fd).detach();
+  }
+}
+
+void inference_service::serve(int fd) {
+  std::vector<double> inputs;
+  while (read_message(fd, inputs)) {
+    std::vector<double> outputs = submit(inputs).get();
+    if (!write_message(fd, outputs))
+      break;
+  }
+
+  // the descriptor is closed with the lock held so stop_listening never
+  // shuts down a number that has been reused
+  std::lock_guard<std::mutex> lock (connections_mutex);
+  ::close(fd);
+  connections.erase(std::find(connections.begin(), connections.end(), fd));
+  connections_closed.notify_all();
+}
+
+// CLIENT ---------------------------------------------------------------------
+
+bool inference_client::connect(const std::string& path) {
+  sockaddr_un address;
+  close();
+  if (!unix_address(path, address))
+    return false;
+
+  fd = ::socket(AF_UNIX, SOCK_STREAM, 0);
+  if (fd < 0)
+    return false;
+  if (::connect(fd, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0) {
+    close();
+    return false;
+  }
+  return true;
+}
+
+void inference_client::close() {
+  if (fd >= 0)
+    ::close(fd);
+  fd = -1;
+}
+
+bool inference_client::evaluate(const std::vector<double>& inputs, std::vector<double>& outputs) {
+  if (fd < 0 || !write_message(fd, inputs) || !read_message(fd, outputs))
+    return false;
+  return !outputs.empty();
+}
@@ -0,0 +1,194 @@
+/*
+ * <one line to give the program's name and a brief idea of what it does.>
+ * Copyright (C) 2018  Daniel Darias Sánchez <dariasteam94@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef INFERENCE_SERVICE_H
+#define INFERENCE_SERVICE_H
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <future>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "concurrent_neural_network.h"
+
+/**
+ * @brief Counters of an #inference_service since it was started
+ */
+struct inference_stats {
+  uint64_t requests;
+  uint64_t batches;
+  unsigned largest_batch;
+
+  double mean_batch () const { return batches ? double(requests) / batches : 0; }
+};
+
+/**
+ * @brief Front end that evaluates requests of any number of threads in
+ * micro-batches. Every request gets a future; a dispatcher thread gathers
+ * the queued requests into a batch of at most max_batch samples and
+ * evaluates them with a single batched call of the net, so the cost of each
+ * pass over the topology is shared by the whole batch.
+ *
+ * The first request of a batch waits at most max_wait for others to join it.
+ * The wait is adaptive: the dispatcher keeps the mean time between
+ * arrivals and stops waiting as soon as the next request is not expected
+ * before the deadline, or when nothing has arrived for several mean
+ * intervals, so a lone request under light load is evaluated at once, the
+ * end of a burst is not delayed and the batches only grow while requests
+ * keep arriving.
+ *
+ * Requests are independent samples of a batch: all of them see the recurrent
+ * state of the service context (zero unless #restore is called) and none of
+ * them modifies it, so the result of a request does not depend on the
+ * requests it was batched with.
+ *
+ * Local processes can submit requests through a Unix domain socket, see
+ * #listen and #inference_client.
+ */
+class inference_service {
+private:
+  typedef std::chrono::steady_clock clock;
+
+  struct request {
+    std::vector<double> inputs;
+    std::promise<std::vector<double>> result;
+    clock::time_point arrival;
+  };
+
+  const concurrent_neural_network& net;
+  unsigned max_batch;
+  std::chrono::microseconds max_wait;
+
+  evaluation_context context;
+  std::mutex context_mutex;
+
+  std::deque<request> queue;
+  std::mutex mutex;
+  std::condition_variable pending;
+  bool stopping;
+  // mean seconds between arrivals, exponentially weighted
+  double arrival_interval;
+  clock::time_point last_arrival;
+  inference_stats stats;
+
+  std::thread dispatcher;
+
+  // SOCKET LISTENER
+  int listener;
+  std::string socket_path;
+  std::thread acceptor;
+  std::mutex connections_mutex;
+  std::condition_variable connections_closed;
+  std::vector<int> connections;
+
+  void dispatch ();
+  void evaluate (std::vector<request>& batch);
+  void accept_connections ();
+
+  /**
+   * @brief Answers the requests of one socket connection until it is closed
+   */
+  void serve (int fd);
+
+public:
+  /**
+   * @param net p_net: net to evaluate, which must outlive the service
+   * @param max_batch p_max_batch: maximum number of requests evaluated together
+   * @param max_wait p_max_wait: maximum time the oldest queued request waits
+   * for the batch to fill
+   */
+  inference_service (const concurrent_neural_network& net, unsigned max_batch = 64,
+                     std::chrono::microseconds max_wait = std::chrono::microseconds(500));
+
+  /**
+   * @brief Stops listening and evaluates the queued requests before
+   * returning
+   */
+  ~inference_service ();
+
+  inference_service (const inference_service&) = delete;
+  inference_service& operator= (const inference_service&) = delete;
+
+  /**
+   * @brief Queues the evaluation of a sample. Thread safe.
+   *
+   * @return std::future< std::vector< double > > outputs of the net, empty if
+   * inputs has not the right size or the service is stopping
+   */
+  std::future<std::vector<double>> submit (std::vector<double> inputs);
+
+  /**
+   * @brief Sets the recurrent state seen by the requests from a
+   * #concurrent_neural_network::snapshot of the same net
+   *
+   * @return bool false if the state does not belong to the net
+   */
+  bool restore (const std::vector<double>& state);
+
+  /**
+   * @brief Accepts connections on a Unix domain socket created at path
+   * (replacing any file there). Each message is a uint32 count followed by
+   * that many doubles in host byte order: the inputs in a request and the
+   * outputs in its answer, which has count 0 if the request was rejected.
+   * Every connection is served by its own thread and can send any number
+   * of requests, one after the other.
+   *
+   * @return bool false if the socket can not be created or the service is
+   * already listening
+   */
+  bool listen (const std::string& path);
+
+  /**
+   * @brief Closes the socket and every open connection
+   */
+  void stop_listening ();
+
+  inference_stats get_stats ();
+};
+
+/**
+ * @brief Connection to the socket of an #inference_service
+ */
+class inference_client {
+private:
+  int fd;
+
+public:
+  inference_client () : fd(-1) {}
+  ~inference_client () { close(); }
+
+  inference_client (const inference_client&) = delete;
+  inference_client& operator= (const inference_client&) = delete;
+
+  bool connect (const std::string& path);
+  void close ();
+
+  /**
+   * @brief Sends a request and waits for its answer
+   *
+   * @return bool false if the connection failed or the request was rejected
+   */
+  bool evaluate (const std::vector<double>& inputs, std::vector<double>& outputs);
+};
+
+#endif // INFERENCE_SERVICE_H
@@ -0,0 +1,374 @@
+/*
+ * <one line to give the program's name and a brief idea of what it does.>
+ * Copyright (C) 2018  Daniel Darias Sánchez <dariasteam94@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "kernels.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define X86_KERNELS
+#endif
+
+using namespace fast_tanh_coefficients;
+
+// SCALAR ---------------------------------------------------------------------
+
+static void scalar_accumulate(double* acc, const double* x, double w, unsigned n) {
+  for (unsigned b = 0; b < n; b++)
+    acc[b] += x[b] * w;
+}
+
+static void scalar_add(double* acc, const double* x, unsigned n) {
+  for (unsigned b = 0; b < n; b++)
+    acc[b] += x[b];
+}
+
+static void scalar_add_constant(double* acc, double c, unsigned n) {
+  for (unsigned b = 0; b < n; b++)
+    acc[b] += c;
+}
+
+static void scalar_activate(double* v, unsigned n, double fan_in, double threshold, tanh_mode mode) {
+  for (unsigned b = 0; b < n; b++)
+    v[b] = activation((v[b] / fan_in) + threshold, mode);
+}
+
+static void scalar_multiply_accumulate(double* acc, const double* x, const double* w, unsigned n) {
+  for (unsigned b = 0; b < n; b++)
+    acc[b] += x[b] * w[b];
+}
+
+static void scalar_activate_lanes(double* v, unsigned n, double fan_in, const double* thresholds, tanh_mode mode) {
+  for (unsigned b = 0; b < n; b++)
+    v[b] = activation((v[b] / fan_in) + thresholds[b], mode);
+}
+
+static const kernel_set scalar_kernels = {
+  "scalar", scalar_accumulate, scalar_add, scalar_add_constant, scalar_activate,
+  scalar_multiply_accumulate, scalar_activate_lanes
+};
+
+#ifdef X86_KERNELS
+
+// SSE2 -----------------------------------------------------------------------
+
+__attribute__((target("sse2")))
+static __m128d sse2_fast_tanh(__m128d x) {
+  x = _mm_min_pd(_mm_set1_pd(clamp), _mm_max_pd(_mm_set1_pd(-clamp), x));
+  __m128d x2 = _mm_mul_pd(x, x);
+  __m128d p = _mm_add_pd(_mm_mul_pd(x2, _mm_set1_pd(alpha_13)), _mm_set1_pd(alpha_11));
+  p = _mm_add_pd(_mm_mul_pd(p, x2), _mm_set1_pd(alpha_9));
+  p = _mm_add_pd(_mm_mul_pd(p, x2), _mm_set1_pd(alpha_7));
+  p = _mm_add_pd(_mm_mul_pd(p, x2), _mm_set1_pd(alpha_5));
+  p = _mm_add_pd(_mm_mul_pd(p, x2), _mm_set1_pd(alpha_3));
+  p = _mm_add_pd(_mm_mul_pd(p, x2), _mm_set1_pd(alpha_1));
+  p = _mm_mul_pd(p, x);
+  __m128d q = _mm_add_pd(_mm_mul_pd(x2, _mm_set1_pd(beta_6)), _mm_set1_pd(beta_4));
+  q = _mm_add_pd(_mm_mul_pd(q, x2), _mm_set1_pd(beta_2));
+  q = _mm_add_pd(_mm_mul_pd(q, x2), _mm_set1_pd(beta_0));
+  return _mm_div_pd(p, q);
+}
+
+__attribute__((target("sse2")))
+static void sse2_accumulate(double* acc, const double* x, double w, unsigned n) {
+  __m128d vw = _mm_set1_pd(w);
+  unsigned b = 0;
+  for (; b + 2 <= n; b += 2)
+    _mm_storeu_pd(acc + b, _mm_add_pd(_mm_loadu_pd(acc + b), _mm_mul_pd(_mm_loadu_pd(x + b), vw)));
+  scalar_accumulate(acc + b, x + b, w, n - b);
+}
+
+__attribute__((target("sse2")))
+static void sse2_add(double* acc, const double* x, unsigned n) {
+  unsigned b = 0;
+  for (; b + 2 <= n; b += 2)
+    _mm_storeu_pd(acc + b, _mm_add_pd(_mm_loadu_pd(acc + b), _mm_loadu_pd(x + b)));
+  scalar_add(acc + b, x + b, n - b);
+}
+
+__attribute__((target("sse2")))
+static void sse2_add_constant(double* acc, double c, unsigned n) {
+  __m128d vc = _mm_set1_pd(c);
+  unsigned b = 0;
+  for (; b + 2 <= n; b += 2)
+    _mm_storeu_pd(acc + b, _mm_add_pd(_mm_loadu_pd(acc + b), vc));
+  scalar_add_constant(acc + b, c, n - b);
+}
+
+__attribute__((target("sse2")))
+static void sse2_activate(double* v, unsigned n, double fan_in, double threshold, tanh_mode mode) {
+  __m128d vf = _mm_set1_pd(fan_in);
+  __m128d vt = _mm_set1_pd(threshold);
+  unsigned b = 0;
+  for (; b + 2 <= n; b += 2) {
+    __m128d x = _mm_add_pd(_mm_div_pd(_mm_loadu_pd(v + b), vf), vt);
+    if (mode == tanh_mode::fast) {
+      _mm_storeu_pd(v + b, sse2_fast_tanh(x));
+    } else {
+      _mm_storeu_pd(v + b, x);
+      v[b] = std::tanh(v[b]);
+      v[b + 1] = std::tanh(v[b + 1]);
+    }
+  }
+  scalar_activate(v + b, n - b, fan_in, threshold, mode);
+}
+
+__attribute__((target("sse2")))
+static void sse2_multiply_accumulate(double* acc, const double* x, const double* w, unsigned n) {
+  unsigned b = 0;
+  for (; b + 2 <= n; b += 2)
+    _mm_storeu_pd(acc + b, _mm_add_pd(_mm_loadu_pd(acc + b), _mm_mul_pd(_mm_loadu_pd(x + b), _mm_loadu_pd(w + b))));
+  scalar_multiply_accumulate(acc + b, x + b, w + b, n - b);
+}
+
+__attribute__((target("sse2")))
+static void sse2_activate_lanes(double* v, unsigned n, double fan_in, const double* thresholds, tanh_mode mode) {
+  __m128d vf = _mm_set1_pd(fan_in);
+  unsigned b = 0;
+  for (; b + 2 <= n; b += 2) {
+    __m128d x = _mm_add_pd(_mm_div_pd(_mm_loadu_pd(v + b), vf), _mm_loadu_pd(thresholds + b));
+    if (mode == tanh_mode::fast) {
+      _mm_storeu_pd(v + b, sse2_fast_tanh(x));
+    } else {
+      _mm_storeu_pd(v + b, x);
+      for (unsigned k = b; k < b + 2; k++)
+        v[k] = std::tanh(v[k]);
+    }
+  }
+  scalar_activate_lanes(v + b, n - b, fan_in, thresholds + b, mode);
+}
+
+static const kernel_set sse2_kernels = {
+  "sse2", sse2_accumulate, sse2_add, sse2_add_constant, sse2_activate,
+  sse2_multiply_accumulate, sse2_activate_lanes
+};
+
+// AVX2 -----------------------------------------------------------------------
+
+// the SSE2 tails are legacy encoded, so the upper halves are cleared before
+// calling them to avoid the AVX-SSE transition penalty on every call
+
+__attribute__((target("avx2")))
+static __m256d avx2_fast_tanh(__m256d x) {
+  x = _mm256_min_pd(_mm256_set1_pd(clamp), _mm256_max_pd(_mm256_set1_pd(-clamp), x));
+  __m256d x2 = _mm256_mul_pd(x, x);
+  __m256d p = _mm256_add_pd(_mm256_mul_pd(x2, _mm256_set1_pd(alpha_13)), _mm256_set1_pd(alpha_11));
+  p = _mm256_add_pd(_mm256_mul_pd(p, x2), _mm256_set1_pd(alpha_9));
+  p = _mm256_add_pd(_mm256_mul_pd(p, x2), _mm256_set1_pd(alpha_7));
+  p = _mm256_add_pd(_mm256_mul_pd(p, x2), _mm256_set1_pd(alpha_5));
+  p = _mm256_add_pd(_mm256_mul_pd(p, x2), _mm256_set1_pd(alpha_3));
+  p = _mm256_add_pd(_mm256_mul_pd(p, x2), _mm256_set1_pd(alpha_1));
+  p = _mm256_mul_pd(p, x);
+  __m256d q = _mm256_add_pd(_mm256_mul_pd(x2, _mm256_set1_pd(beta_6)), _mm256_set1_pd(beta_4));
+  q = _mm256_add_pd(_mm256_mul_pd(q, x2), _mm256_set1_pd(beta_2));
+  q = _mm256_add_pd(_mm256_mul_pd(q, x2), _mm256_set1_pd(beta_0));
+  return _mm256_div_pd(p, q);
+}
+
+__attribute__((target("avx2")))
+static void avx2_accumulate(double* acc, const double* x, double w, unsigned n) {
+  __m256d vw = _mm256_set1_pd(w);
+  unsigned b = 0;
+  for (; b + 4 <= n; b += 4)
+    _mm256_storeu_pd(acc + b, _mm256_add_pd(_mm256_loadu_pd(acc + b), _mm256_mul_pd(_mm256_loadu_pd(x + b), vw)));
+  _mm256_zeroupper();
+  sse2_accumulate(acc + b, x + b, w, n - b);
+}
+
+__attribute__((target("avx2")))
+static void avx2_add(double* acc, const double* x, unsigned n) {
+  unsigned b = 0;
+  for (; b + 4 <= n; b += 4)
+    _mm256_storeu_pd(acc + b, _mm256_add_pd(_mm256_loadu_pd(acc + b), _mm256_loadu_pd(x + b)));
+  _mm256_zeroupper();
+  sse2_add(acc + b, x + b, n - b);
+}
+
+__attribute__((target("avx2")))
+static void avx2_add_constant(double* acc, double c, unsigned n) {
+  __m256d vc = _mm256_set1_pd(c);
+  unsigned b = 0;
+  for (; b + 4 <= n; b += 4)
+    _mm256_storeu_pd(acc + b, _mm256_add_pd(_mm256_loadu_pd(acc + b), vc));
+  _mm256_zeroupper();
+  sse2_add_constant(acc + b, c, n - b);
+}
+
+__attribute__((target("avx2")))
+static void avx2_activate(double* v, unsigned n, double fan_in, double threshold, tanh_mode mode) {
+  __m256d vf = _mm256_set1_pd(fan_in);
+  __m256d vt = _mm256_set1_pd(threshold);
+  unsigned b = 0;
+  for (; b + 4 <= n; b += 4) {
+    __m256d x = _mm256_add_pd(_mm256_div_pd(_mm256_loadu_pd(v + b), vf), vt);
+    if (mode == tanh_mode::fast) {
+      _mm256_storeu_pd(v + b, avx2_fast_tanh(x));
+    } else {
+      _mm256_storeu_pd(v + b, x);
+      for (unsigned k = b; k < b + 4; k++)
+        v[k] = std::tanh(v[k]);
+    }
+  }
+  _mm256_zeroupper();
+  sse2_activate(v + b, n - b, fan_in, threshold, mode);
+}
+
+__attribute__((target("avx2")))
+static void avx2_multiply_accumulate(double* acc, const double* x, const double* w, unsigned n) {
+  unsigned b = 0;
+  for (; b + 4 <= n; b += 4)
+    _mm256_storeu_pd(acc + b, _mm256_add_pd(_mm256_loadu_pd(acc + b), _mm256_mul_pd(_mm256_loadu_pd(x + b), _mm256_loadu_pd(w + b))));
+  _mm256_zeroupper();
+  sse2_multiply_accumulate(acc + b, x + b, w + b, n - b);
+}
+
+__attribute__((target("avx2")))
+static void avx2_activate_lanes(double* v, unsigned n, double fan_in, const double* thresholds, tanh_mode mode) {
+  __m256d vf = _mm256_set1_pd(fan_in);
+  unsigned b = 0;
+  for (; b + 4 <= n; b += 4) {
+    __m256d x = _mm256_add_pd(_mm256_div_pd(_mm256_loadu_pd(v + b), vf), _mm256_loadu_pd(thresholds + b));
+    if (mode == tanh_mode::fast) {
+      _mm256_storeu_pd(v + b, avx2_fast_tanh(x));
+    } else {
+      _mm256_storeu_pd(v + b, x);
+      for (unsigned k = b; k < b + 4; k++)
+        v[k] = std::tanh(v[k]);
+    }
+  }
+  _mm256_zeroupper();
+  sse2_activate_lanes(v + b, n - b, fan_in, thresholds + b, mode);
+}
+
+static const kernel_set avx2_kernels = {
+  "avx2", avx2_accumulate, avx2_add, avx2_add_constant, avx2_activate,
+  avx2_multiply_accumulate, avx2_activate_lanes
+};
+
+// AVX-512 --------------------------------------------------------------------
+
+__attribute__((target("avx512f")))
+static __m512d avx512_fast_tanh(__m512d x) {
+  x = _mm512_min_pd(_mm512_set1_pd(clamp), _mm512_max_pd(_mm512_set1_pd(-clamp), x));
+  __m512d x2 = _mm512_mul_pd(x, x);
+  __m512d p = _mm512_add_pd(_mm512_mul_pd(x2, _mm512_set1_pd(alpha_13)), _mm512_set1_pd(alpha_11));
+  p = _mm512_add_pd(_mm512_mul_pd(p, x2), _mm512_set1_pd(alpha_9));
+  p = _mm512_add_pd(_mm512_mul_pd(p, x2), _mm512_set1_pd(alpha_7));
+  p = _mm512_add_pd(_mm512_mul_pd(p, x2), _mm512_set1_pd(alpha_5));
+  p = _mm512_add_pd(_mm512_mul_pd(p, x2), _mm512_set1_pd(alpha_3));
+  p = _mm512_add_pd(_mm512_mul_pd(p, x2), _mm512_set1_pd(alpha_1));
+  p = _mm512_mul_pd(p, x);
+  __m512d q = _mm512_add_pd(_mm512_mul_pd(x2, _mm512_set1_pd(beta_6)), _mm512_set1_pd(beta_4));
+  q = _mm512_add_pd(_mm512_mul_pd(q, x2), _mm512_set1_pd(beta_2));
+  q = _mm512_add_pd(_mm512_mul_pd(q, x2), _mm512_set1_pd(beta_0));
+  return _mm512_div_pd(p, q);
+}
+
+__attribute__((target("avx512f")))
+static void avx512_accumulate(double* acc, const double* x, double w, unsigned n) {
+  __m512d vw = _mm512_set1_pd(w);
+  unsigned b = 0;
+  for (; b + 8 <= n; b += 8)
+    _mm512_storeu_pd(acc + b, _mm512_add_pd(_mm512_loadu_pd(acc + b), _mm512_mul_pd(_mm512_loadu_pd(x + b), vw)));
+  avx2_accumulate(acc + b, x + b, w, n - b);
+}
+
+__attribute__((target("avx512f")))
+static void avx512_add(double* acc, const double* x, unsigned n) {
+  unsigned b = 0;
+  for (; b + 8 <= n; b += 8)
+    _mm512_storeu_pd(acc + b, _mm512_add_pd(_mm512_loadu_pd(acc + b), _mm512_loadu_pd(x + b)));
+  avx2_add(acc + b, x + b, n - b);
+}
+
+__attribute__((target("avx512f")))
+static void avx512_add_constant(double* acc, double c, unsigned n) {
+  __m512d vc = _mm512_set1_pd(c);
+  unsigned b = 0;
+  for (; b + 8 <= n; b += 8)
+    _mm512_storeu_pd(acc + b, _mm512_add_pd(_mm512_loadu_pd(acc + b), vc));
+  avx2_add_constant(acc + b, c, n - b);
+}
+
+__attribute__((target("avx512f")))
+static void avx512_activate(double* v, unsigned n, double fan_in, double threshold, tanh_mode mode) {
+  __m512d vf = _mm512_set1_pd(fan_in);
+  __m512d vt = _mm512_set1_pd(threshold);
+  unsigned b = 0;
+  for (; b + 8 <= n; b += 8) {
+    __m512d x = _mm512_add_pd(_mm512_div_pd(_mm512_loadu_pd(v + b), vf), vt);
+    if (mode == tanh_mode::fast) {
+      _mm512_storeu_pd(v + b, avx512_fast_tanh(x));
+    } else {
+      _mm512_storeu_pd(v + b, x);
+      for (unsigned k = b; k < b + 8; k++)
+        v[k] = std::tanh(v[k]);
+    }
+  }
+  avx2_activate(v + b, n - b, fan_in, threshold, mode);
+}
+
+__attribute__((target("avx512f")))
+static void avx512_multiply_accumulate(double* acc, const double* x, const double* w, unsigned n) {
+  unsigned b = 0;
+  for (; b + 8 <= n; b += 8)
+    _mm512_storeu_pd(acc + b, _mm512_add_pd(_mm512_loadu_pd(acc + b), _mm512_mul_pd(_mm512_loadu_pd(x + b), _mm512_loadu_pd(w + b))));
+  avx2_multiply_accumulate(acc + b, x + b, w + b, n - b);
+}
+
+__attribute__((target("avx512f")))
+static void avx512_activate_lanes(double* v, unsigned n, double fan_in, const double* thresholds, tanh_mode mode) {
+  __m512d vf = _mm512_set1_pd(fan_in);
+  unsigned b = 0;
+  for (; b + 8 <= n; b += 8) {
+    __m512d x = _mm512_add_pd(_mm512_div_pd(_mm512_loadu_pd(v + b), vf), _mm512_loadu_pd(thresholds + b));
+    if (mode == tanh_mode::fast) {
+      _mm512_storeu_pd(v + b, avx512_fast_tanh(x));
+    } else {
+      _mm512_storeu_pd(v + b, x);
+      for (unsigned k = b; k < b + 8; k++)
+        v[k] = std::tanh(v[k]);
+    }
+  }
+  avx2_activate_lanes(v + b, n - b, fan_in, thresholds + b, mode);
+}
+
+static const kernel_set avx512_kernels = {
+  "avx512", avx512_accumulate, avx512_add, avx512_add_constant, avx512_activate,
+  avx512_multiply_accumulate, avx512_activate_lanes
+};
+
+#endif // X86_KERNELS
+
+std::vector<const kernel_set*> available_kernels() {
+  std::vector<const kernel_set*> solve {&scalar_kernels};
+#ifdef X86_KERNELS
+  __builtin_cpu_init();
+  if (__builtin_cpu_supports("sse2"))
+    solve.push_back(&sse2_kernels);
+  if (__builtin_cpu_supports("avx2"))
+    solve.push_back(&avx2_kernels);
+  if (__builtin_cpu_supports("avx512f"))
+    solve.push_back(&avx512_kernels);
+#endif
+  return solve;
+}
+
+const kernel_set& best_kernels() {
+  static const kernel_set* best = available_kernels().back();
+  return *best;
+}
@@ -0,0 +1,109 @@
+/*
+ * <one line to give the program's name and a brief idea of what it does.>
+ * Copyright (C) 2018  Daniel Darias Sánchez <dariasteam94@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef KERNELS_H
+#define KERNELS_H
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+/**
+ * @brief How the activation function is calculated.
+ *
+ * exact uses std::tanh. fast uses a [13/6] rational approximation over
+ * [-7.99881, 7.99881] (saturating outside), whose absolute error against
+ * std::tanh is below 3e-7 for every double.
+ */
+enum class tanh_mode { exact, fast };
+
+namespace fast_tanh_coefficients {
+  const double clamp = 7.99881172180175781;
+  const double alpha_1 = 4.89352455891786e-03;
+  const double alpha_3 = 6.37261928875436e-04;
+  const double alpha_5 = 1.48572235717979e-05;
+  const double alpha_7 = 5.12229709037114e-08;
+  const double alpha_9 = -8.60467152213735e-11;
+  const double alpha_11 = 2.00018790482477e-13;
+  const double alpha_13 = -2.76076847742355e-16;
+  const double beta_0 = 4.89352518554385e-03;
+  const double beta_2 = 2.26843463243900e-03;
+  const double beta_4 = 1.18534705686654e-04;
+  const double beta_6 = 1.19825839466702e-06;
+}
+
+/**
+ * @brief Scalar version of the fast tanh. The vector kernels perform exactly
+ * the same operations, so every kernel set gives the same bits.
+ */
+inline double fast_tanh (double x) {
+  using namespace fast_tanh_coefficients;
+  x = std::min(clamp, std::max(-clamp, x));
+  double x2 = x * x;
+  double p = x2 * alpha_13 + alpha_11;
+  p = p * x2 + alpha_9;
+  p = p * x2 + alpha_7;
+  p = p * x2 + alpha_5;
+  p = p * x2 + alpha_3;
+  p = p * x2 + alpha_1;
+  p = p * x;
+  double q = x2 * beta_6 + beta_4;
+  q = q * x2 + beta_2;
+  q = q * x2 + beta_0;
+  return p / q;
+}
+
+inline double activation (double x, tanh_mode mode) {
+  return (mode == tanh_mode::fast) ? fast_tanh(x) : std::tanh(x);
+}
+
+/**
+ * @brief Set of vector kernels used by the batched evaluation. All of them
+ * work over n contiguous doubles with no alignment requirements and never
+ * fuse multiplications and additions (the Makefile builds with
+ * -ffp-contract=off), so the results are identical to the scalar loops.
+ */
+struct kernel_set {
+  const char* name;
+
+  /** acc[b] += x[b] * w */
+  void (*accumulate) (double* acc, const double* x, double w, unsigned n);
+  /** acc[b] += x[b] */
+  void (*add) (double* acc, const double* x, unsigned n);
+  /** acc[b] += c */
+  void (*add_constant) (double* acc, double c, unsigned n);
+  /** v[b] = tanh (v[b] / fan_in + threshold) */
+  void (*activate) (double* v, unsigned n, double fan_in, double threshold, tanh_mode mode);
+  /** acc[b] += x[b] * w[b] */
+  void (*multiply_accumulate) (double* acc, const double* x, const double* w, unsigned n);
+  /** v[b] = tanh (v[b] / fan_in + thresholds[b]) */
+  void (*activate_lanes) (double* v, unsigned n, double fan_in, const double* thresholds, tanh_mode mode);
+};
+
+/**
+ * @brief Kernel sets supported by this CPU, from the plain scalar loops to the
+ * widest instruction set available
+ */
+std::vector<const kernel_set*> available_kernels ();
+
+/**
+ * @brief Widest kernel set supported by this CPU, detected once at runtime
+ */
+const kernel_set& best_kernels ();
+
+#endif // KERNELS_H
@@ -9,11 +9,12 @@
 #include <chrono>
 #include <fstream>
 #include <string>
+#include <memory>
 
-#include "neuron.h"
-#include "axon.h"
-#include "feedback_bus.h"
 #include "concurrent_neural_network.h"
+#include "net_io.h"
+#include "network_placement.h"
+#include "random_nets.h"
 
 
 template <class T>
@@ -30,73 +31,6 @@ void print_matrix (const std::vector<std::vector<T>>& graph) {
 }
 
 
-std::vector<std::vector<bool>> random_graph_generator(unsigned N) {
-  std::vector<std::vector<bool>> vec;
-  unsigned size = N + 1;
-  vec.resize(size);
-  for (unsigned i = 0; i < size; i++) {
-    vec[i].resize(size);
-    for (unsigned j = 0; j < size; j++) {
-      if (rand() % 15 < 1)
-        vec[i][j] = true;
-      else
-        vec[i][j] = false;
-    }
-  }
-  return vec;
-}
-
-std::vector<std::vector<double>> random_costs_generator(unsigned N) {
-  std::vector<std::vector<double>> vec;
-  unsigned size = N + 1;
-  vec.resize(size);
-  for (unsigned i = 0; i < size; i++) {
-    vec[i].resize(size);
-    for (unsigned j = 0; j < size; j++)
-      vec[i][j] = double(-1000 + (std::rand() % 2000)) / 1000;
-  }
-  return vec;
-}
-
-void read_net_from_file (std::string filename, std::vector<std::vector<bool>>& graph,
-                                               std::vector<std::vector<double>>& costs) {
-  std::ifstream file;
-
-  graph.resize(0);
-  costs.resize(0);
-
-  unsigned size;
-
-  file.open(filename);
-  if (file.is_open()) {
-    file >> size;
-    graph.resize(size);
-    costs.resize(size);
-
-    // READ GRAPH
-
-    for (unsigned i = 0; i < size; i++) {
-      graph[i].resize(size);
-      costs[i].resize(size);
-      for (unsigned j = 0; j < size; j++) {
-        bool aux;
-        file >> aux;
-        graph[i][j] = aux;
-      }
-    }
-
-    // READ COSTS
-
-    for (unsigned i = 0; i < size; i++) {
-      for (unsigned j = 0; j < size; j++) {
-        double aux;
-        file >> aux;
-        costs[i][j] = aux;
-      }
-    }
-  }
-}
-
 int main(int argc, char **argv) {
   srand(time(nullptr));
   std::vector<std::vector<bool>> vec_graph;
@@ -106,16 +40,37 @@ int main(int argc, char **argv) {
   vec_costs = random_costs_generator(50);
 */
 
-  read_net_from_file ("testfile.dat", vec_graph, vec_costs);
+  // a compiled net saved by net_convert can be given instead of testfile.dat,
+  // and --numa spreads the networks over the NUMA nodes
+  bool numa = false;
+  const char* net_file = nullptr;
+  for (int k = 1; k < argc; k++) {
+    if (std::string(argv[k]) == "--numa")
+      numa = true;
+    else
+      net_file = argv[k];
+  }
+
+  compiled_network compiled;
+  bool binary = net_file && compiled_network::load(net_file, compiled);
+  if (!binary)
+    read_net_from_file ("testfile.dat", vec_graph, vec_costs);
 
 
   unsigned n_networks = 80;
 
-  std::vector<concurrent_neural_network*> c_nns (n_networks);
+  // the calling thread also calculates, as in thread_pool::shared
+  unsigned hardware = std::thread::hardware_concurrency();
+  thread_pool pool (hardware > 1 ? hardware - 1 : 0);
+
+  std::vector<std::unique_ptr<concurrent_neural_network>> c_nns (n_networks);
   std::vector<std::future<void>> promises (n_networks);
 
   auto op_generate = [&](unsigned i) {
-    c_nns[i] = new concurrent_neural_network (vec_graph, vec_costs, 3, 2);
+    if (binary)
+      c_nns[i].reset(new concurrent_neural_network (compiled, &pool));
+    else
+      c_nns[i].reset(new concurrent_neural_network (vec_graph, vec_costs, 3, 2, &pool));
   };
 
   for (unsigned i = 0; i < n_networks; i++)
@@ -125,8 +80,17 @@ int main(int argc, char **argv) {
     promises[i].get();
 
   std::cout << "Redes generadas" << std::endl;
+
+  std::unique_ptr<network_placement> placement;
+  if (numa) {
+    placement.reset(new network_placement());
+    for (auto& net : c_nns)
+      placement->assign(*net);
+    std::cout << placement->n_nodes() << " nodos NUMA"
+              << (numa_topology::system().has_libnuma() ? "" : " (sin libnuma)") << std::endl;
+  }
   std::cout << "Net is calculated in " << c_nns[0]->c_steps()
-  << " concurrent steps" << std::endl;
+  << " concurrent steps (" << c_nns[0]->n_levels() << " levels)" << std::endl;
 
   std::vector<double> inputs{1, 1, 1};
 
@@ -139,11 +103,19 @@ int main(int argc, char **argv) {
   auto begin = std::chrono::high_resolution_clock::now();
   unsigned counter = 0;
   while (true) {
-    for (unsigned i = 0; i < n_networks; i++)
-      promises[i] = std::async(op_evaluate, i);
+    if (placement) {
+      placement->evaluate([&](concurrent_neural_network& net) {
+        std::vector<double> outputs;
+        net(inputs, outputs);
+        std::cout << outputs[0] << ' ' << outputs[1] << std::endl;
+      });
+    } else {
+      for (unsigned i = 0; i < n_networks; i++)
+        promises[i] = std::async(op_evaluate, i);
 
-    for (unsigned i = 0; i < n_networks; i++)
-      promises[i].get();
+      for (unsigned i = 0; i < n_networks; i++)
+        promises[i].get();
+    }
 
     if (counter < 10) {
       counter++;
@@ -151,6 +123,12 @@ int main(int argc, char **argv) {
       auto end = std::chrono::high_resolution_clock::now();
       double time = std::chrono::duration_cast<std::chrono::milliseconds>(end - begin).count();
       std::cout << "Fin evaluación " << time / 1000 << std::endl;
+      if (placement) {
+        for (const node_throughput& node : placement->throughput())
+          std::cout << "Nodo " << node.node_id << ": " << node.networks << " redes, "
+                    << node.evaluations_per_second() << " evaluaciones/s" << std::endl;
+        placement->reset_throughput();
+      }
       counter = 0;
       begin = std::chrono::high_resolution_clock::now();
     }
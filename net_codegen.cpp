@@ -0,0 +1,52 @@
+/*
+ * <one line to give the program's name and a brief idea of what it does.>
+ * Copyright (C) 2018  Daniel Darias Sánchez <dariasteam94@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <iostream>
+#include <string>
+
+#include "code_generator.h"
+
+/**
+ * Generates the C++ source of a net saved in the binary format (see
+ * net_convert), exporting its entry points with the given prefix:
+ *
+ *   net_codegen <binary net> <source file> [name] [exact|fast]
+ */
+int main(int argc, char **argv) {
+  if (argc < 3 || argc > 5) {
+    std::cerr << "usage: " << argv[0] << " <binary net> <source file> [name] [exact|fast]" << std::endl;
+    return 1;
+  }
+
+  compiled_network net;
+  if (!compiled_network::load(argv[1], net)) {
+    std::cerr << "can not load " << argv[1] << std::endl;
+    return 1;
+  }
+
+  std::string name = (argc > 3) ? argv[3] : "network";
+  if (argc > 4)
+    net.set_tanh_mode(std::string(argv[4]) == "fast" ? tanh_mode::fast : tanh_mode::exact);
+
+  if (!write_network_source(net, name, argv[2])) {
+    std::cerr << "can not write " << argv[2] << " with the name " << name
+              << " (or the net has a value that is not finite)" << std::endl;
+    return 1;
+  }
+  return 0;
+}
@@ -0,0 +1,67 @@
+/*
+ * <one line to give the program's name and a brief idea of what it does.>
+ * Copyright (C) 2018  Daniel Darias Sánchez <dariasteam94@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "concurrent_neural_network.h"
+#include "net_io.h"
+
+/**
+ * Converts a net in the dense text format (testfile.dat) or in one of the
+ * sparse formats (see #read_sparse_net_from_file) into the binary format,
+ * already pruned and compiled:
+ *
+ *   net_convert <text net> <binary net> <inputs> <outputs>
+ */
+int main(int argc, char **argv) {
+  if (argc != 5) {
+    std::cerr << "usage: " << argv[0] << " <text net> <binary net> <inputs> <outputs>" << std::endl;
+    return 1;
+  }
+
+  unsigned inputs = std::atoi(argv[3]);
+  unsigned outputs = std::atoi(argv[4]);
+
+  std::vector<double> thresholds;
+  std::vector<network_edge> edges;
+  std::vector<std::vector<bool>> vec_graph;
+  std::vector<std::vector<double>> vec_costs;
+
+  bool sparse = read_sparse_net_from_file(argv[1], thresholds, edges);
+  if (!sparse)
+    read_net_from_file(argv[1], vec_graph, vec_costs);
+
+  unsigned size = sparse ? thresholds.size() : vec_graph.size();
+  if (size == 0 || inputs + outputs > size) {
+    std::cerr << "can not read a net with " << inputs << " inputs and "
+              << outputs << " outputs from " << argv[1] << std::endl;
+    return 1;
+  }
+
+  concurrent_neural_network net = sparse
+    ? concurrent_neural_network (edges, thresholds, inputs, outputs)
+    : concurrent_neural_network (vec_graph, vec_costs, inputs, outputs);
+  if (!net.save(argv[2])) {
+    std::cerr << "can not write " << argv[2] << std::endl;
+    return 1;
+  }
+  return 0;
+}
@@ -0,0 +1,333 @@
+/*
+ * <one line to give the program's name and a brief idea of what it does.>
+ * Copyright (C) 2018  Daniel Darias Sánchez <dariasteam94@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "net_io.h"
+
+void read_net_from_file (std::string filename, std::vector<std::vector<bool>>& graph,
+                                               std::vector<std::vector<double>>& costs) {
+  std::ifstream file;
+
+  graph.resize(0);
+  costs.resize(0);
+
+  unsigned size;
+
+  file.open(filename);
+  if (file.is_open()) {
+    file >> size;
+    graph.resize(size);
+    costs.resize(size);
+
+    // READ GRAPH
+
+    for (unsigned i = 0; i < size; i++) {
+      graph[i].resize(size);
+      costs[i].resize(size);
+      for (unsigned j = 0; j < size; j++) {
+        bool aux;
+        file >> aux;
+        graph[i][j] = aux;
+      }
+    }
+
+    // READ COSTS
+
+    for (unsigned i = 0; i < size; i++) {
+      for (unsigned j = 0; j < size; j++) {
+        double aux;
+        file >> aux;
+        costs[i][j] = aux;
+      }
+    }
+  }
+}
+
+static_assert(sizeof(network_edge) == 16, "network_edge is stored as is in binary sparse files");
+
+static bool read_sparse_text(std::ifstream& file, std::vector<double>& thresholds,
+                             std::vector<network_edge>& edges) {
+  std::string word;
+  unsigned size;
+  uint64_t n_edges;
+  if (!(file >> word >> size >> n_edges) || word != "sparse")
+    return false;
+
+  thresholds.resize(size);
+  for (unsigned i = 0; i < size; i++)
+    if (!(file >> thresholds[i]))
+      return false;
+
+  edges.reserve(std::min<uint64_t>(n_edges, 1 << 20));
+  for (uint64_t k = 0; k < n_edges; k++) {
+    network_edge edge;
+    if (!(file >> edge.from >> edge.to >> edge.weight))
+      return false;
+    edges.push_back(edge);
+  }
+  return true;
+}
+
+static bool read_sparse_binary(std::ifstream& file, std::vector<double>& thresholds,
+                               std::vector<network_edge>& edges) {
+  uint32_t size;
+  uint64_t n_edges;
+  if (!file.read(reinterpret_cast<char*>(&size), sizeof(size)) ||
+      !file.read(reinterpret_cast<char*>(&n_edges), sizeof(n_edges)))
+    return false;
+
+  // the file must be at least as long as it claims before allocating
+  std::streamoff start = file.tellg();
+  file.seekg(0, std::ios::end);
+  std::streamoff length = file.tellg() - start;
+  file.seekg(start);
+  if (length < 0 || uint64_t(length) / sizeof(network_edge) < n_edges ||
+      uint64_t(length) - n_edges * sizeof(network_edge) < uint64_t(size) * sizeof(double))
+    return false;
+
+  thresholds.resize(size);
+  edges.resize(n_edges);
+  file.read(reinterpret_cast<char*>(thresholds.data()), size * sizeof(double));
+  file.read(reinterpret_cast<char*>(edges.data()), n_edges * sizeof(network_edge));
+  return bool(file);
+}
+
+bool read_sparse_net_from_file(const std::string& filename, std::vector<double>& thresholds,
+                               std::vector<network_edge>& edges) {
+  thresholds.clear();
+  edges.clear();
+
+  std::ifstream file (filename, std::ios::binary);
+  if (!file.is_open())
+    return false;
+
+  char magic[sizeof(sparse_network_magic)] = {};
+  file.read(magic, sizeof(magic));
+  bool binary = file && std::memcmp(magic, sparse_network_magic, sizeof(magic)) == 0;
+  if (!binary) {
+    file.clear();
+    file.seekg(0);
+  }
+
+  bool ok = binary ? read_sparse_binary(file, thresholds, edges)
+                   : read_sparse_text(file, thresholds, edges);
+  for (unsigned k = 0; ok && k < edges.size(); k++)
+    ok = edges[k].from < thresholds.size() && edges[k].to < thresholds.size();
+
+  if (!ok) {
+    thresholds.clear();
+    edges.clear();
+  }
+  return ok;
+}
+
+bool write_sparse_net_file(const std::string& filename, const std::vector<double>& thresholds,
+                           const std::vector<network_edge>& edges, bool binary) {
+  if (binary) {
+    std::ofstream file (filename, std::ios::binary | std::ios::trunc);
+    if (!file.is_open())
+      return false;
+    uint32_t size = thresholds.size();
+    uint64_t n_edges = edges.size();
+    file.write(sparse_network_magic, sizeof(sparse_network_magic));
+    file.write(reinterpret_cast<const char*>(&size), sizeof(size));
+    file.write(reinterpret_cast<const char*>(&n_edges), sizeof(n_edges));
+    file.write(reinterpret_cast<const char*>(thresholds.data()), size * sizeof(double));
+    file.write(reinterpret_cast<const char*>(edges.data()), n_edges * sizeof(network_edge));
+    return bool(file);
+  }
+
+  std::ofstream file (filename, std::ios::trunc);
+  if (!file.is_open())
+    return false;
+  file.precision(17);
+  file << "sparse " << thresholds.size() << ' ' << edges.size() << '\n';
+  for (unsigned i = 0; i < thresholds.size(); i++)
+    file << thresholds[i] << (i + 1 < thresholds.size() ? ' ' : '\n');
+  for (const network_edge& edge : edges)
+    file << edge.from << ' ' << edge.to << ' ' << edge.weight << '\n';
+  return bool(file);
+}
+
+uint64_t network_checksum(const char* image, uint64_t file_size) {
+  const uint64_t* words = reinterpret_cast<const uint64_t*>(image);
+  uint64_t n_words = file_size / sizeof(uint64_t);
+  // the checksum field is hashed as zero
+  const uint64_t checksum_word = offsetof(network_file_header, checksum) / sizeof(uint64_t);
+
+  uint64_t hash = 14695981039346656037ULL;
+  for (uint64_t k = 0; k < n_words; k++) {
+    hash ^= (k == checksum_word) ? 0 : words[k];
+    hash *= 1099511628211ULL;
+  }
+  return hash;
+}
+
+std::shared_ptr<char> allocate_network_image(uint64_t file_size) {
+  void* image = nullptr;
+  if (posix_memalign(&image, network_alignment, file_size) != 0)
+    return std::shared_ptr<char>();
+  std::memset(image, 0, file_size);
+  return std::shared_ptr<char>(static_cast<char*>(image), std::free);
+}
+
+void network_section_lengths(const network_file_header& header, uint64_t lengths[N_SECTIONS]) {
+  uint64_t nodes = header.size;
+  lengths[ROW_OFFSETS] = (nodes + 1) * sizeof(uint32_t);
+  lengths[SOURCES] = header.n_forward * sizeof(uint32_t);
+  lengths[WEIGHTS] = header.n_forward * sizeof(double);
+  lengths[OUT_OFFSETS] = (nodes + 1) * sizeof(uint32_t);
+  lengths[TARGETS] = header.n_forward * sizeof(uint32_t);
+  lengths[FEEDBACK_OFFSETS] = (nodes + 1) * sizeof(uint32_t);
+  lengths[FEEDBACK_SOURCES] = header.n_feedback * sizeof(uint32_t);
+  lengths[FEEDBACK_WEIGHTS] = header.n_feedback * sizeof(double);
+  lengths[FEEDBACK_ORIGINS] = header.n_registers * sizeof(uint32_t);
+  lengths[THRESHOLDS] = nodes * sizeof(double);
+  lengths[FAN_IN] = nodes * sizeof(double);
+  lengths[NEURON_IDS] = nodes * sizeof(uint32_t);
+}
+
+static bool valid_header(const network_file_header& header, uint64_t file_size) {
+  if (std::memcmp(header.magic, network_magic, sizeof(network_magic)) != 0 ||
+      header.version != network_version || header.file_size != file_size)
+    return false;
+
+  uint64_t lengths[N_SECTIONS];
+  network_section_lengths(header, lengths);
+
+  for (unsigned s = 0; s < N_SECTIONS; s++) {
+    if (header.sections[s] % network_alignment != 0 ||
+        header.sections[s] < network_header_size ||
+        header.sections[s] > file_size ||
+        lengths[s] > file_size - header.sections[s])
+      return false;
+  }
+  return header.inputs <= header.size && header.outputs <= header.size - header.inputs;
+}
+
+// offsets of n rows that start at 0, never decrease and end at edges
+static bool valid_offsets(const uint32_t* offsets, uint32_t n, uint32_t edges) {
+  if (offsets[0] != 0 || offsets[n] != edges)
+    return false;
+  for (uint32_t j = 0; j < n; j++)
+    if (offsets[j] > offsets[j + 1])
+      return false;
+  return true;
+}
+
+/**
+ * @brief Checks that the sections of an image with a valid header describe a
+ * net the executors can walk without leaving it: offsets in order, forward
+ * sources below and targets above their neuron, feedback sources at or above
+ * it, the transpose with the same edges into every neuron and increasing
+ * register origins, all of them inside the net
+ */
+static bool valid_sections(const char* image, const network_file_header& header) {
+  auto section = [&](network_section s) {
+    return reinterpret_cast<const uint32_t*>(image + header.sections[s]);
+  };
+  const uint32_t* row_offsets = section(ROW_OFFSETS);
+  const uint32_t* sources = section(SOURCES);
+  const uint32_t* out_offsets = section(OUT_OFFSETS);
+  const uint32_t* targets = section(TARGETS);
+  const uint32_t* feedback_offsets = section(FEEDBACK_OFFSETS);
+  const uint32_t* feedback_sources = section(FEEDBACK_SOURCES);
+  const uint32_t* origins = section(FEEDBACK_ORIGINS);
+  uint32_t size = header.size;
+
+  if (!valid_offsets(row_offsets, size, header.n_forward) ||
+      !valid_offsets(out_offsets, size, header.n_forward) ||
+      !valid_offsets(feedback_offsets, size, header.n_feedback))
+    return false;
+
+  // every target is counted back from the predecessors of its neuron
+  std::vector<uint32_t> pending (size);
+  for (uint32_t j = 0; j < size; j++) {
+    pending[j] = row_offsets[j + 1] - row_offsets[j];
+    for (uint32_t k = row_offsets[j]; k < row_offsets[j + 1]; k++)
+      if (sources[k] >= j)
+        return false;
+    for (uint32_t k = feedback_offsets[j]; k < feedback_offsets[j + 1]; k++)
+      if (feedback_sources[k] < j || feedback_sources[k] >= size)
+        return false;
+  }
+  for (uint32_t i = 0; i < size; i++) {
+    for (uint32_t k = out_offsets[i]; k < out_offsets[i + 1]; k++) {
+      uint32_t j = targets[k];
+      if (j <= i || j >= size || pending[j] == 0)
+        return false;
+      pending[j]--;
+    }
+  }
+
+  for (uint32_t r = 0; r < header.n_registers; r++)
+    if (origins[r] >= size || (r > 0 && origins[r] <= origins[r - 1]))
+      return false;
+  return true;
+}
+
+std::shared_ptr<const char> map_network_file(const std::string& filename, bool verify) {
+  int fd = open(filename.c_str(), O_RDONLY);
+  if (fd < 0)
+    return std::shared_ptr<const char>();
+
+  struct stat info;
+  if (fstat(fd, &info) != 0 || uint64_t(info.st_size) < network_header_size) {
+    close(fd);
+    return std::shared_ptr<const char>();
+  }
+
+  uint64_t file_size = info.st_size;
+  void* address = mmap(nullptr, file_size, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);
+  if (address == MAP_FAILED)
+    return std::shared_ptr<const char>();
+
+  std::shared_ptr<const char> image (static_cast<const char*>(address), [file_size](const char* p) {
+    munmap(const_cast<char*>(p), file_size);
+  });
+
+  const network_file_header& header = *reinterpret_cast<const network_file_header*>(image.get());
+  if (!valid_header(header, file_size))
+    return std::shared_ptr<const char>();
+  if (verify && network_checksum(image.get(), file_size) != header.checksum)
+    return std::shared_ptr<const char>();
+  if (!valid_sections(image.get(), header))
+    return std::shared_ptr<const char>();
+
+  return image;
+}
+
+bool write_network_file(const std::string& filename, const char* image,
+                        const network_file_header& header) {
+  std::ofstream file (filename, std::ios::binary | std::ios::trunc);
+  if (!file.is_open())
+    return false;
+  file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+  file.write(image + sizeof(header), header.file_size - sizeof(header));
+  return bool(file);
+}
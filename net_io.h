@@ -0,0 +1,152 @@
+/*
+ * <one line to give the program's name and a brief idea of what it does.>
+ * Copyright (C) 2018  Daniel Darias Sánchez <dariasteam94@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef NET_IO_H
+#define NET_IO_H
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+/**
+ * @brief Reads a net in the dense text format: the number of neurons followed
+ * by the adjacency matrix and the cost matrix. Both matrices are left empty
+ * if the file can not be opened.
+ */
+void read_net_from_file (std::string filename, std::vector<std::vector<bool>>& graph,
+                                               std::vector<std::vector<double>>& costs);
+
+/**
+ * @brief Connection of a sparse net. from < to is a forward connection and
+ * from > to a feedback one, as in the upper and lower triangles of the
+ * dense adjacency matrix.
+ */
+struct network_edge {
+  unsigned from;
+  unsigned to;
+  double weight;
+};
+
+const char sparse_network_magic[8] = {'C', 'N', 'N', 'E', 'D', 'G', 'E', '\0'};
+
+/**
+ * @brief Reads a net in one of the sparse formats, whose size is
+ * proportional to the connections instead of the square of the neurons:
+ *
+ *  - text: the word "sparse", the number of neurons and of connections, the
+ *    threshold of every neuron and one "from to weight" line per connection
+ *  - binary: #sparse_network_magic, uint32 neurons, uint64 connections, the
+ *    thresholds as doubles and the connections as #network_edge records
+ *
+ * The format is detected from the first bytes of the file.
+ *
+ * @return false if the file can not be read, is not sparse or has a
+ * connection to a neuron out of range. Both vectors are left empty then.
+ */
+bool read_sparse_net_from_file (const std::string& filename, std::vector<double>& thresholds,
+                                std::vector<network_edge>& edges);
+
+/**
+ * @brief Writes a net in the sparse text format, or in the binary one if
+ * binary is set
+ */
+bool write_sparse_net_file (const std::string& filename, const std::vector<double>& thresholds,
+                            const std::vector<network_edge>& edges, bool binary = false);
+
+/**
+ * @brief Arrays of a compiled net, in the order they are stored
+ */
+enum network_section {
+  ROW_OFFSETS, SOURCES, WEIGHTS,
+  OUT_OFFSETS, TARGETS,
+  FEEDBACK_OFFSETS, FEEDBACK_SOURCES, FEEDBACK_WEIGHTS, FEEDBACK_ORIGINS,
+  THRESHOLDS, FAN_IN, NEURON_IDS,
+  N_SECTIONS
+};
+
+const char network_magic[8] = {'C', 'N', 'N', 'B', 'I', 'N', '\0', '\0'};
+// 2: feedback sources are neuron indices instead of register slots
+// 3: original index of every neuron (NEURON_IDS)
+// 4: the checksum covers the header
+const uint32_t network_version = 4;
+const uint64_t network_alignment = 64;
+
+/**
+ * @brief Header of a compiled net image. The same image is used in memory
+ * and in binary files, so loading a file is just mapping it.
+ *
+ * The header is followed by every #network_section, each one starting at a
+ * multiple of #network_alignment bytes and padded with zeros. Indices are
+ * uint32 and weights double, in the byte order of the host that wrote it.
+ * The checksum is FNV-1a over the 64 bit words of the whole image, header
+ * included, with the checksum field taken as zero.
+ */
+struct network_file_header {
+  char magic[8];
+  uint32_t version;
+  uint32_t size;
+  uint32_t inputs;
+  uint32_t outputs;
+  uint32_t n_forward;
+  uint32_t n_feedback;
+  uint32_t n_registers;
+  uint32_t reserved;
+  uint64_t sections[N_SECTIONS];
+  uint64_t file_size;
+  uint64_t checksum;
+};
+
+const uint64_t network_header_size =
+  (sizeof(network_file_header) + network_alignment - 1) / network_alignment * network_alignment;
+
+static_assert(offsetof(network_file_header, checksum) % sizeof(uint64_t) == 0,
+              "the checksum must be a whole word of the header");
+
+uint64_t network_checksum (const char* image, uint64_t file_size);
+
+/**
+ * @brief Length in bytes of every section of the image described by header,
+ * without the padding
+ */
+void network_section_lengths (const network_file_header& header, uint64_t lengths[N_SECTIONS]);
+
+/**
+ * @brief Allocates an image of the given size aligned to #network_alignment
+ * and filled with zeros
+ */
+std::shared_ptr<char> allocate_network_image (uint64_t file_size);
+
+/**
+ * @brief Maps a binary net read only. The mapping is released with the last
+ * copy of the returned pointer.
+ *
+ * @return null if the file can not be mapped or is not a valid image of this
+ * version (bad magic, sections out of bounds, wrong checksum or connections
+ * that leave the net or go the wrong way)
+ */
+std::shared_ptr<const char> map_network_file (const std::string& filename, bool verify = true);
+
+/**
+ * @brief Writes an image, with header in place of the one it holds
+ */
+bool write_network_file (const std::string& filename, const char* image,
+                         const network_file_header& header);
+
+#endif // NET_IO_H
@@ -0,0 +1,409 @@
+/*
+ * <one line to give the program's name and a brief idea of what it does.>
+ * Copyright (C) 2018  Daniel Darias Sánchez <dariasteam94@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include <algorithm>
+
+#include "compiled_network.h"
+#include "network_genome.h"
+
+namespace {
+
+bool by_neuron(const genome_connection& a, const genome_connection& b) {
+  return a.neuron < b.neuron;
+}
+
+// turns counts per row, stored one position ahead, into offsets
+void accumulate_offsets(std::vector<unsigned>& offsets) {
+  for (unsigned i = 1; i < offsets.size(); i++)
+    offsets[i] += offsets[i - 1];
+}
+
+}
+
+network_genome::network_genome(const std::vector<std::vector<bool>>& vec_graph,
+                               const std::vector<std::vector<double>>& vec_costs,
+                               unsigned int inps, unsigned int outs) :
+                               inputs(inps),
+                               outputs(outs),
+                               thresholds(vec_graph.size()),
+                               predecessor_offsets(vec_graph.size() + 1, 0),
+                               alive_changes(0) {
+  unsigned n = size();
+  for (unsigned i = 0; i < n; i++)
+    for (unsigned j = 0; j < n; j++)
+      if (i != j && vec_graph[i][j])
+        predecessor_offsets[j + 1]++;
+  accumulate_offsets(predecessor_offsets);
+
+  // the rows are visited in order, so every column is filled sorted
+  predecessors.resize(predecessor_offsets[n]);
+  std::vector<unsigned> cursor (predecessor_offsets.begin(), predecessor_offsets.end() - 1);
+  for (unsigned i = 0; i < n; i++) {
+    thresholds[i] = vec_costs[i][i];
+    for (unsigned j = 0; j < n; j++)
+      if (i != j && vec_graph[i][j])
+        predecessors[cursor[j]++] = genome_connection {i, vec_costs[i][j]};
+  }
+  transpose();
+  find_reachable();
+}
+
+network_genome::network_genome(const std::vector<network_edge>& edges,
+                               const std::vector<double>& vec_thresholds,
+                               unsigned int inps, unsigned int outs) :
+                               inputs(inps),
+                               outputs(outs),
+                               thresholds(vec_thresholds),
+                               predecessor_offsets(vec_thresholds.size() + 1, 0),
+                               alive_changes(0) {
+  unsigned n = size();
+  auto valid = [n](const network_edge& edge) {
+    return edge.from != edge.to && edge.from < n && edge.to < n;
+  };
+  for (const network_edge& edge : edges)
+    if (valid(edge))
+      predecessor_offsets[edge.to + 1]++;
+  accumulate_offsets(predecessor_offsets);
+
+  predecessors.resize(predecessor_offsets[n]);
+  std::vector<unsigned> cursor (predecessor_offsets.begin(), predecessor_offsets.end() - 1);
+  for (const network_edge& edge : edges)
+    if (valid(edge))
+      predecessors[cursor[edge.to]++] = genome_connection {edge.from, edge.weight};
+
+  // sort every column by source and keep the last of the repeated
+  // connections, compacting the columns towards the front
+  unsigned kept = 0;
+  for (unsigned j = 0; j < n; j++) {
+    auto first = predecessors.begin() + predecessor_offsets[j];
+    auto last = predecessors.begin() + predecessor_offsets[j + 1];
+    std::stable_sort(first, last, by_neuron);
+    predecessor_offsets[j] = kept;
+    for (auto k = first; k != last; ++k)
+      if (k + 1 == last || (k + 1)->neuron != k->neuron)
+        predecessors[kept++] = *k;
+  }
+  predecessor_offsets[n] = kept;
+  predecessors.resize(kept);
+
+  transpose();
+  find_reachable();
+}
+
+network_genome::network_genome(const compiled_network& net) :
+                               inputs(net.n_inputs()),
+                               outputs(net.n_outputs()),
+                               thresholds(net.n_neurons()),
+                               predecessor_offsets(net.n_neurons() + 1, 0),
+                               predecessors(net.n_edges()),
+                               alive_changes(0) {
+  unsigned n = size();
+  std::vector<unsigned> order = original_order(net);
+  std::vector<unsigned> position (n);
+  for (unsigned i = 0; i < n; i++)
+    position[order[i]] = i;
+
+  const unsigned* offsets = net.predecessor_offsets();
+  const unsigned* feedback_offsets = net.feedback_predecessor_offsets();
+  unsigned filled = 0;
+  for (unsigned j = 0; j < n; j++) {
+    unsigned k = order[j];
+    thresholds[j] = net.neuron_thresholds()[k];
+    predecessor_offsets[j] = filled;
+    for (unsigned e = offsets[k]; e < offsets[k + 1]; e++)
+      predecessors[filled++] = genome_connection {position[net.predecessors()[e]], net.forward_weights()[e]};
+    for (unsigned e = feedback_offsets[k]; e < feedback_offsets[k + 1]; e++)
+      predecessors[filled++] = genome_connection {position[net.feedback_predecessors()[e]],
+                                                  net.feedback_connection_weights()[e]};
+    // a reordered net does not sum in index order
+    std::sort(predecessors.begin() + predecessor_offsets[j], predecessors.begin() + filled, by_neuron);
+  }
+  predecessor_offsets[n] = filled;
+
+  transpose();
+  find_reachable();
+}
+
+std::vector<unsigned> network_genome::original_order(const compiled_network& net) {
+  const unsigned* ids = net.original_neurons();
+  std::vector<unsigned> order (net.n_neurons());
+  for (unsigned k = 0; k < order.size(); k++)
+    order[k] = k;
+  std::sort(order.begin(), order.end(), [ids](unsigned a, unsigned b) { return ids[a] < ids[b]; });
+  return order;
+}
+
+void network_genome::transpose() {
+  unsigned n = size();
+  sucessor_offsets.assign(n + 1, 0);
+  for (const genome_connection& connection : predecessors)
+    sucessor_offsets[connection.neuron + 1]++;
+  accumulate_offsets(sucessor_offsets);
+
+  // the columns are visited in order, so every row is filled sorted
+  sucessors.resize(predecessors.size());
+  std::vector<unsigned> cursor (sucessor_offsets.begin(), sucessor_offsets.end() - 1);
+  for (unsigned j = 0; j < n; j++)
+    for (const genome_connection& connection : connections(j))
+      sucessors[cursor[connection.neuron]++] = j;
+}
+
+void network_genome::mark(std::vector<bool>& reached, unsigned i, bool value) {
+  bool was = alive(i);
+  reached[i] = value;
+  if (alive(i) != was)
+    alive_changes++;
+}
+
+void network_genome::find_reachable() {
+  unsigned n = size();
+  unsigned first_output = n - outputs;
+  from_inputs.assign(n, false);
+  to_outputs.assign(n, false);
+
+  // forward connections always go to a higher index, so one pass in index
+  // order (and one in reverse order) is enough
+  for (unsigned j = 0; j < n; j++) {
+    bool reached = j < inputs;
+    for (const genome_connection& connection : connections(j))
+      reached = reached || (connection.neuron < j && from_inputs[connection.neuron]);
+    from_inputs[j] = reached;
+  }
+  for (unsigned i = n; i-- > 0;) {
+    bool reached = i >= first_output;
+    for (unsigned j : sucessors_of(i))
+      reached = reached || (j > i && to_outputs[j]);
+    to_outputs[i] = reached;
+  }
+}
+
+void network_genome::reach(unsigned from, unsigned to) {
+  // the searches only grow: continue them from the new connection
+  std::vector<unsigned> pending;
+  if (from_inputs[from] && !from_inputs[to]) {
+    mark(from_inputs, to, true);
+    pending.push_back(to);
+    while (!pending.empty()) {
+      unsigned i = pending.back();
+      pending.pop_back();
+      for (unsigned j : sucessors_of(i)) {
+        if (j > i && !from_inputs[j]) {
+          mark(from_inputs, j, true);
+          pending.push_back(j);
+        }
+      }
+    }
+  }
+
+  if (to_outputs[to] && !to_outputs[from]) {
+    mark(to_outputs, from, true);
+    pending.push_back(from);
+    while (!pending.empty()) {
+      unsigned j = pending.back();
+      pending.pop_back();
+      for (const genome_connection& connection : connections(j)) {
+        unsigned i = connection.neuron;
+        if (i < j && !to_outputs[i]) {
+          mark(to_outputs, i, true);
+          pending.push_back(i);
+        }
+      }
+    }
+  }
+}
+
+void network_genome::unreach(unsigned from, unsigned to) {
+  unsigned first_output = size() - outputs;
+
+  // only the neurons reached from the inputs through to can lose their path.
+  // They are cleared and then decided again in index order, so every
+  // predecessor is decided before its sucessors
+  if (from_inputs[from] && from_inputs[to]) {
+    std::vector<std::pair<unsigned, bool>> cone;
+    auto enter = [&](unsigned i) {
+      cone.push_back(std::make_pair(i, alive(i)));
+      from_inputs[i] = false;
+    };
+    enter(to);
+    for (unsigned k = 0; k < cone.size(); k++) {
+      unsigned i = cone[k].first;
+      for (unsigned j : sucessors_of(i))
+        if (j > i && from_inputs[j])
+          enter(j);
+    }
+
+    std::sort(cone.begin(), cone.end());
+    for (const std::pair<unsigned, bool>& entry : cone) {
+      unsigned j = entry.first;
+      bool reached = j < inputs;
+      for (const genome_connection& connection : connections(j))
+        reached = reached || (connection.neuron < j && from_inputs[connection.neuron]);
+      from_inputs[j] = reached;
+      if (alive(j) != entry.second)
+        alive_changes++;
+    }
+  }
+
+  // the same for the neurons that reached the outputs through from, in
+  // reverse index order
+  if (to_outputs[from] && to_outputs[to]) {
+    std::vector<std::pair<unsigned, bool>> cone;
+    auto enter = [&](unsigned i) {
+      cone.push_back(std::make_pair(i, alive(i)));
+      to_outputs[i] = false;
+    };
+    enter(from);
+    for (unsigned k = 0; k < cone.size(); k++) {
+      unsigned j = cone[k].first;
+      for (const genome_connection& connection : connections(j))
+        if (connection.neuron < j && to_outputs[connection.neuron])
+          enter(connection.neuron);
+    }
+
+    std::sort(cone.rbegin(), cone.rend());
+    for (const std::pair<unsigned, bool>& entry : cone) {
+      unsigned i = entry.first;
+      bool reached = i >= first_output;
+      for (unsigned j : sucessors_of(i))
+        reached = reached || (j > i && to_outputs[j]);
+      to_outputs[i] = reached;
+      if (alive(i) != entry.second)
+        alive_changes++;
+    }
+  }
+}
+
+void network_genome::shift(unsigned position, int delta) {
+  auto renumber = [&](unsigned& i) {
+    if (i >= position)
+      i += delta;
+  };
+  for (genome_connection& connection : predecessors)
+    renumber(connection.neuron);
+  for (unsigned& j : sucessors)
+    renumber(j);
+}
+
+std::vector<unsigned> network_genome::alive_neurons() const {
+  std::vector<unsigned> alive_set;
+  for (unsigned i = 0; i < size(); i++)
+    if (alive(i))
+      alive_set.push_back(i);
+  return alive_set;
+}
+
+const genome_connection* network_genome::find(unsigned from, unsigned to) const {
+  if (from >= size() || to >= size())
+    return nullptr;
+  genome_range<genome_connection> column = connections(to);
+  const genome_connection* k = std::lower_bound(column.begin(), column.end(),
+                                                genome_connection {from, 0}, by_neuron);
+  return (k != column.end() && k->neuron == from) ? k : nullptr;
+}
+
+bool network_genome::set_weight(unsigned from, unsigned to, double weight) {
+  if (from == to && from < size()) {
+    thresholds[from] = weight;
+    return true;
+  }
+  const genome_connection* connection = find(from, to);
+  if (!connection)
+    return false;
+  predecessors[connection - predecessors.data()].weight = weight;
+  return true;
+}
+
+bool network_genome::add_edge(unsigned from, unsigned to, double weight) {
+  if (from == to || from >= size() || to >= size() || find(from, to))
+    return false;
+
+  genome_connection connection {from, weight};
+  genome_range<genome_connection> column = connections(to);
+  unsigned k = std::upper_bound(column.begin(), column.end(), connection, by_neuron) - predecessors.data();
+  predecessors.insert(predecessors.begin() + k, connection);
+  for (unsigned j = to + 1; j < predecessor_offsets.size(); j++)
+    predecessor_offsets[j]++;
+
+  genome_range<unsigned> row = sucessors_of(from);
+  k = std::upper_bound(row.begin(), row.end(), to) - sucessors.data();
+  sucessors.insert(sucessors.begin() + k, to);
+  for (unsigned i = from + 1; i < sucessor_offsets.size(); i++)
+    sucessor_offsets[i]++;
+
+  if (from < to)
+    reach(from, to);
+  return true;
+}
+
+bool network_genome::remove_edge(unsigned from, unsigned to) {
+  const genome_connection* connection = find(from, to);
+  if (!connection)
+    return false;
+
+  predecessors.erase(predecessors.begin() + (connection - predecessors.data()));
+  for (unsigned j = to + 1; j < predecessor_offsets.size(); j++)
+    predecessor_offsets[j]--;
+
+  genome_range<unsigned> row = sucessors_of(from);
+  unsigned k = std::lower_bound(row.begin(), row.end(), to) - sucessors.data();
+  sucessors.erase(sucessors.begin() + k);
+  for (unsigned i = from + 1; i < sucessor_offsets.size(); i++)
+    sucessor_offsets[i]--;
+
+  if (from < to)
+    unreach(from, to);
+  return true;
+}
+
+bool network_genome::insert_neuron(unsigned position, double threshold) {
+  if (position < inputs || position > size() - outputs)
+    return false;
+
+  // an empty row and column at position
+  shift(position, 1);
+  thresholds.insert(thresholds.begin() + position, threshold);
+  predecessor_offsets.insert(predecessor_offsets.begin() + position, predecessor_offsets[position]);
+  sucessor_offsets.insert(sucessor_offsets.begin() + position, sucessor_offsets[position]);
+  from_inputs.insert(from_inputs.begin() + position, false);
+  to_outputs.insert(to_outputs.begin() + position, false);
+  return true;
+}
+
+bool network_genome::remove_neuron(unsigned i) {
+  if (i < inputs || i >= size() - outputs)
+    return false;
+
+  genome_range<genome_connection> column = connections(i);
+  std::vector<unsigned> sources;
+  for (const genome_connection& connection : column)
+    sources.push_back(connection.neuron);
+  for (unsigned from : sources)
+    remove_edge(from, i);
+  genome_range<unsigned> row = sucessors_of(i);
+  std::vector<unsigned> targets (row.begin(), row.end());
+  for (unsigned j : targets)
+    remove_edge(i, j);
+
+  // its row and column are empty now
+  thresholds.erase(thresholds.begin() + i);
+  predecessor_offsets.erase(predecessor_offsets.begin() + i);
+  sucessor_offsets.erase(sucessor_offsets.begin() + i);
+  from_inputs.erase(from_inputs.begin() + i);
+  to_outputs.erase(to_outputs.begin() + i);
+  shift(i + 1, -1);
+  return true;
+}
@@ -0,0 +1,218 @@
+/*
+ * <one line to give the program's name and a brief idea of what it does.>
+ * Copyright (C) 2018  Daniel Darias Sánchez <dariasteam94@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef NETWORK_GENOME_H
+#define NETWORK_GENOME_H
+
+#include <vector>
+
+#include "net_io.h"
+
+class compiled_network;
+
+struct genome_connection {
+  unsigned neuron;
+  double weight;
+};
+
+/**
+ * @brief Contiguous run of one of the arrays of a genome
+ */
+template <typename T>
+struct genome_range {
+  const T* first;
+  const T* last;
+
+  const T* begin () const { return first; }
+  const T* end () const { return last; }
+  unsigned size () const { return last - first; }
+};
+
+/**
+ * @brief Whole net, pruned neurons included, in a form that can be mutated
+ * one connection at a time. The predecessors and the sucessors of every
+ * neuron are kept sorted by index in two flat CSR arrays, so a genome is a
+ * fixed number of allocations whatever the size of the net. A connection is
+ * found in time logarithmic in the connections of its destination; adding
+ * or removing one shifts the arrays, in time proportional to the
+ * connections of the net, as the compilation that usually follows.
+ *
+ * Neurons are numbered as in the matrices (inputs first, outputs last) and
+ * a connection is forward when it goes to a higher index and feedback
+ * otherwise. The genome also keeps which neurons are reached from the inputs
+ * and which reach the outputs through forward connections, the two searches
+ * of #concurrent_neural_network::find_useful_nodes, and updates them after
+ * every mutation visiting only the neurons whose answer can change.
+ */
+class network_genome {
+private:
+  unsigned inputs;
+  unsigned outputs;
+
+  std::vector<double> thresholds;
+  // predecessors of neuron j in [predecessor_offsets[j], predecessor_offsets[j + 1])
+  std::vector<unsigned> predecessor_offsets;
+  std::vector<genome_connection> predecessors;
+  // sucessors of neuron i in [sucessor_offsets[i], sucessor_offsets[i + 1])
+  std::vector<unsigned> sucessor_offsets;
+  std::vector<unsigned> sucessors;
+
+  std::vector<bool> from_inputs;
+  std::vector<bool> to_outputs;
+  unsigned alive_changes;
+
+  genome_range<unsigned> sucessors_of (unsigned i) const {
+    return genome_range<unsigned> {sucessors.data() + sucessor_offsets[i],
+                                   sucessors.data() + sucessor_offsets[i + 1]};
+  }
+
+  /**
+   * @brief Fills the sucessors from the predecessors, which must be sorted
+   */
+  void transpose ();
+
+  /**
+   * @brief Sets one of the search results of neuron i, counting the change
+   * if it prunes or revives the neuron
+   */
+  void mark (std::vector<bool>& reached, unsigned i, bool value);
+
+  /**
+   * @brief Both searches over the whole genome, in index order
+   */
+  void find_reachable ();
+
+  /**
+   * @brief Updates the searches after adding the forward connection
+   * (from, to)
+   */
+  void reach (unsigned from, unsigned to);
+
+  /**
+   * @brief Updates the searches after removing the forward connection
+   * (from, to)
+   */
+  void unreach (unsigned from, unsigned to);
+
+  /**
+   * @brief Renumbers every neuron from position on by delta
+   */
+  void shift (unsigned position, int delta);
+
+public:
+  /**
+   * @brief Genome of the net described by the matrices
+   *
+   * @param vec_graph p_vec_graph: adjacency matrix of the net
+   * @param vec_costs p_vec_costs: weights of the net, thresholds in the diagonal
+   */
+  network_genome (const std::vector<std::vector<bool>>& vec_graph,
+                  const std::vector<std::vector<double>>& vec_costs,
+                  unsigned inps, unsigned outs);
+
+  /**
+   * @brief Genome of a sparse net, read as #compiled_network does
+   */
+  network_genome (const std::vector<network_edge>& edges,
+                  const std::vector<double>& vec_thresholds,
+                  unsigned inps, unsigned outs);
+
+  /**
+   * @brief Genome of an already compiled net. The neurons are numbered in
+   * the order of their original indices (see #original_order), so the
+   * numbering does not depend on how the net was reordered. The neurons
+   * pruned before compiling it are lost.
+   */
+  explicit network_genome (const compiled_network& net);
+
+  /**
+   * @brief Compiled indices of the neurons of net sorted by their
+   * #compiled_network::original_neurons index: the order they had when the
+   * net was compiled, before any reordering
+   */
+  static std::vector<unsigned> original_order (const compiled_network& net);
+
+  unsigned size () const { return thresholds.size(); }
+  unsigned n_inputs () const { return inputs; }
+  unsigned n_outputs () const { return outputs; }
+
+  double threshold (unsigned i) const { return thresholds[i]; }
+
+  /**
+   * @brief Connections that reach neuron j, sorted by the index of their
+   * source, which is the order they are summed in
+   */
+  genome_range<genome_connection> connections (unsigned j) const {
+    return genome_range<genome_connection> {predecessors.data() + predecessor_offsets[j],
+                                            predecessors.data() + predecessor_offsets[j + 1]};
+  }
+
+  /**
+   * @brief Whether the neuron is kept when the net is compiled: inputs,
+   * outputs and neurons in a forward path from an input to an output
+   */
+  bool alive (unsigned i) const {
+    return i < inputs || i >= size() - outputs || (from_inputs[i] && to_outputs[i]);
+  }
+
+  std::vector<unsigned> alive_neurons () const;
+
+  /**
+   * @brief Number of times a neuron has been pruned or revived by a
+   * mutation, so the caller can tell whether a mutation changed the
+   * compiled net
+   */
+  unsigned pruning_changes () const { return alive_changes; }
+
+  /**
+   * @brief Connection (from, to), null if there is none
+   */
+  const genome_connection* find (unsigned from, unsigned to) const;
+
+  // MUTATIONS --------------------------------------------------------------
+
+  /**
+   * @brief Changes the weight of an existing connection, or the threshold of
+   * the neuron if from and to are the same, as in the cost matrix
+   */
+  bool set_weight (unsigned from, unsigned to, double weight);
+
+  /**
+   * @return bool false if the neurons are the same, out of range or already
+   * connected
+   */
+  bool add_edge (unsigned from, unsigned to, double weight);
+
+  bool remove_edge (unsigned from, unsigned to);
+
+  /**
+   * @brief Inserts a hidden neuron without connections at position,
+   * renumbering the neurons from there on
+   *
+   * @return bool false if position is not in [inputs, size - outputs]
+   */
+  bool insert_neuron (unsigned position, double threshold);
+
+  /**
+   * @brief Removes a hidden neuron and its connections, renumbering the
+   * neurons that follow it
+   */
+  bool remove_neuron (unsigned i);
+};
+
+#endif // NETWORK_GENOME_H
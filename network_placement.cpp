@@ -0,0 +1,81 @@
+/*
+ * <one line to give the program's name and a brief idea of what it does.>
+ * Copyright (C) 2018  Daniel Darias Sánchez <dariasteam94@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <chrono>
+#include <thread>
+
+#include "network_placement.h"
+
+network_placement::network_placement(const numa_topology& t) :
+                                     topology(t),
+                                     assigned(t.n_nodes()) {
+  for (unsigned node = 0; node < topology.n_nodes(); node++) {
+    const std::vector<unsigned>& cpus = topology.cpus(node);
+    // worker i takes cpus[i], the last CPU is left to the thread that
+    // evaluates the node
+    pools.emplace_back(new thread_pool(cpus.empty() ? 0 : cpus.size() - 1, cpus));
+    totals.push_back(node_throughput {node, topology.node_id(node), 0, 0, 0});
+  }
+}
+
+unsigned network_placement::assign(concurrent_neural_network& net) {
+  unsigned node = 0;
+  for (unsigned n = 1; n < assigned.size(); n++)
+    if (assigned[n].size() < assigned[node].size())
+      node = n;
+  assign_to(net, node);
+  return node;
+}
+
+void network_placement::assign_to(concurrent_neural_network& net, unsigned int node) {
+  net.place_on_node(node);
+  net.set_thread_pool(pools[node].get());
+  assigned[node].push_back(&net);
+  totals[node].networks++;
+}
+
+void network_placement::evaluate(const std::function<void (concurrent_neural_network&)>& f) {
+  std::vector<std::thread> nodes;
+  for (unsigned node = 0; node < assigned.size(); node++) {
+    if (assigned[node].empty())
+      continue;
+    nodes.emplace_back([this, node, &f] {
+      const std::vector<unsigned>& cpus = topology.cpus(node);
+      if (!cpus.empty())
+        pin_current_thread({cpus.back()});
+      const std::vector<concurrent_neural_network*>& nets = assigned[node];
+
+      auto begin = std::chrono::steady_clock::now();
+      pools[node]->parallel_for(0, nets.size(), [&](unsigned first, unsigned last) {
+        for (unsigned i = first; i < last; i++)
+          f(*nets[i]);
+      });
+      totals[node].seconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+      totals[node].evaluations += nets.size();
+    });
+  }
+  for (std::thread& node : nodes)
+    node.join();
+}
+
+void network_placement::reset_throughput() {
+  for (node_throughput& total : totals) {
+    total.evaluations = 0;
+    total.seconds = 0;
+  }
+}
@@ -0,0 +1,90 @@
+/*
+ * <one line to give the program's name and a brief idea of what it does.>
+ * Copyright (C) 2018  Daniel Darias Sánchez <dariasteam94@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef NETWORK_PLACEMENT_H
+#define NETWORK_PLACEMENT_H
+
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <vector>
+
+#include "concurrent_neural_network.h"
+#include "numa_placement.h"
+
+/**
+ * @brief Evaluations made by the networks of one node
+ */
+struct node_throughput {
+  unsigned node;
+  int node_id;
+  unsigned networks;
+  uint64_t evaluations;
+  double seconds;
+
+  double evaluations_per_second () const { return (seconds > 0) ? evaluations / seconds : 0; }
+};
+
+/**
+ * @brief Spreads a population of networks over the NUMA nodes. Every node
+ * has a pool with a worker pinned to each of its CPUs but the last one,
+ * which is left to the thread that evaluates the node; a network assigned
+ * to a node is moved to its memory (#concurrent_neural_network::place_on_node)
+ * and calculates its concurrent steps with that pool, so its evaluations
+ * never leave the node.
+ */
+class network_placement {
+private:
+  const numa_topology& topology;
+  std::vector<std::unique_ptr<thread_pool>> pools;
+  std::vector<std::vector<concurrent_neural_network*>> assigned;
+  std::vector<node_throughput> totals;
+
+public:
+  explicit network_placement (const numa_topology& topology = numa_topology::system());
+
+  network_placement (const network_placement&) = delete;
+  network_placement& operator= (const network_placement&) = delete;
+
+  unsigned n_nodes () const { return topology.n_nodes(); }
+
+  /**
+   * @brief Places the net in the node with less networks, see #assign_to
+   *
+   * @return unsigned node of the net
+   */
+  unsigned assign (concurrent_neural_network& net);
+
+  /**
+   * @brief Places the net in node. The net must outlive the placement and
+   * must not be assigned twice.
+   */
+  void assign_to (concurrent_neural_network& net, unsigned node);
+
+  /**
+   * @brief Calls f once for every assigned network from the pool of its
+   * node, all the nodes at the same time, and waits for them. The calls and
+   * the time each node took are added to #throughput.
+   */
+  void evaluate (const std::function<void (concurrent_neural_network&)>& f);
+
+  const std::vector<node_throughput>& throughput () const { return totals; }
+  void reset_throughput ();
+};
+
+#endif // NETWORK_PLACEMENT_H
@@ -0,0 +1,103 @@
+/*
+ * <one line to give the program's name and a brief idea of what it does.>
+ * Copyright (C) 2018  Daniel Darias Sánchez <dariasteam94@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "network_stats.h"
+
+uint64_t network_stats::latency_percentile(double p) const {
+  uint64_t total = 0;
+  for (unsigned k = 0; k < latency_buckets; k++)
+    total += latency_histogram[k];
+  if (total == 0)
+    return 0;
+
+  uint64_t seen = 0;
+  for (unsigned k = 0; k < latency_buckets; k++) {
+    seen += latency_histogram[k];
+    if (seen >= p * total)
+      return uint64_t(1) << (k + 1);
+  }
+  return uint64_t(1) << latency_buckets;
+}
+
+stats_recorder::stats_recorder() : enabled(false), n_steps(0) {
+  reset();
+}
+
+void stats_recorder::resize(unsigned s) {
+  n_steps = s;
+  steps.reset(new atomic_step[s]);
+  reset();
+}
+
+void stats_recorder::reset() {
+  evaluations.store(0);
+  for (unsigned p = 0; p < N_PHASES; p++) {
+    phase_calls[p].store(0);
+    phase_nanoseconds[p].store(0);
+  }
+  for (unsigned k = 0; k < latency_buckets; k++)
+    histogram[k].store(0);
+  for (unsigned s = 0; s < n_steps; s++) {
+    steps[s].calls.store(0);
+    steps[s].nanoseconds.store(0);
+    steps[s].wait_nanoseconds.store(0);
+    steps[s].neurons.store(0);
+    steps[s].edges.store(0);
+  }
+}
+
+void stats_recorder::record_step(unsigned s, uint64_t nanoseconds, uint64_t wait,
+                                 unsigned neurons, unsigned edges) {
+  if (s >= n_steps)
+    return;
+  atomic_step& step = steps[s];
+  step.calls.fetch_add(1, std::memory_order_relaxed);
+  step.nanoseconds.fetch_add(nanoseconds, std::memory_order_relaxed);
+  step.wait_nanoseconds.fetch_add(wait, std::memory_order_relaxed);
+  step.neurons.fetch_add(neurons, std::memory_order_relaxed);
+  step.edges.fetch_add(edges, std::memory_order_relaxed);
+}
+
+void stats_recorder::record_latency(uint64_t nanoseconds) {
+  unsigned bucket = 0;
+  while (bucket + 1 < latency_buckets && (nanoseconds >> (bucket + 1)) != 0)
+    bucket++;
+  histogram[bucket].fetch_add(1, std::memory_order_relaxed);
+  evaluations.fetch_add(1, std::memory_order_relaxed);
+}
+
+network_stats stats_recorder::snapshot() const {
+  network_stats stats;
+  stats.enabled = active();
+  stats.evaluations = evaluations.load(std::memory_order_relaxed);
+  for (unsigned p = 0; p < N_PHASES; p++) {
+    stats.phases[p].calls = phase_calls[p].load(std::memory_order_relaxed);
+    stats.phases[p].nanoseconds = phase_nanoseconds[p].load(std::memory_order_relaxed);
+  }
+  for (unsigned k = 0; k < latency_buckets; k++)
+    stats.latency_histogram[k] = histogram[k].load(std::memory_order_relaxed);
+  stats.steps.resize(n_steps);
+  for (unsigned s = 0; s < n_steps; s++) {
+    stats.steps[s].calls = steps[s].calls.load(std::memory_order_relaxed);
+    stats.steps[s].nanoseconds = steps[s].nanoseconds.load(std::memory_order_relaxed);
+    stats.steps[s].wait_nanoseconds = steps[s].wait_nanoseconds.load(std::memory_order_relaxed);
+    stats.steps[s].neurons = steps[s].neurons.load(std::memory_order_relaxed);
+    stats.steps[s].edges = steps[s].edges.load(std::memory_order_relaxed);
+  }
+  return stats;
+}
@@ -0,0 +1,135 @@
+/*
+ * <one line to give the program's name and a brief idea of what it does.>
+ * Copyright (C) 2018  Daniel Darias Sánchez <dariasteam94@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef NETWORK_STATS_H
+#define NETWORK_STATS_H
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+/**
+ * @brief Parts of an evaluation timed by the instrumentation. feedback and
+ * inputs are only timed separately in the steps and dataflow modes, the
+ * incremental mode counts everything as evaluate.
+ */
+enum network_phase {
+  PHASE_FEEDBACK, PHASE_INPUTS, PHASE_EVALUATE, PHASE_OUTPUTS,
+  N_PHASES
+};
+
+// bucket k of the latency histogram counts latencies in [2^k, 2^(k+1)) ns
+const unsigned latency_buckets = 40;
+
+struct phase_stats {
+  uint64_t calls;
+  uint64_t nanoseconds;
+};
+
+/**
+ * @brief Totals of one concurrent step. wait_nanoseconds adds, for every
+ * chunk of a parallel step, the time between the end of the chunk and the end
+ * of the step, which is what its thread spent waiting at the barrier.
+ */
+struct step_stats {
+  uint64_t calls;
+  uint64_t nanoseconds;
+  uint64_t wait_nanoseconds;
+  uint64_t neurons;
+  uint64_t edges;
+};
+
+/**
+ * @brief Copy of the counters of a net at some point
+ */
+struct network_stats {
+  // false if the instrumentation is compiled out or switched off
+  bool enabled;
+  uint64_t evaluations;
+  phase_stats phases[N_PHASES];
+  std::vector<step_stats> steps;
+  uint64_t latency_histogram[latency_buckets];
+
+  /**
+   * @brief Upper bound of the latency percentile p (in [0, 1]) from the
+   * histogram, in nanoseconds
+   */
+  uint64_t latency_percentile (double p) const;
+};
+
+inline uint64_t stats_clock () {
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(
+         std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+/**
+ * @brief Counters updated by the instrumented evaluations. Every counter is
+ * a relaxed atomic, so evaluations from many threads (one context each) can
+ * record at the same time.
+ *
+ * The recording calls are only made when the library is built with
+ * CNN_INSTRUMENTATION defined (make INSTRUMENTATION=1) and the recorder has
+ * been switched on; otherwise the evaluation does not read the clock at all.
+ */
+class stats_recorder {
+private:
+  struct atomic_step {
+    std::atomic<uint64_t> calls;
+    std::atomic<uint64_t> nanoseconds;
+    std::atomic<uint64_t> wait_nanoseconds;
+    std::atomic<uint64_t> neurons;
+    std::atomic<uint64_t> edges;
+  };
+
+  std::atomic<bool> enabled;
+  std::atomic<uint64_t> evaluations;
+  std::atomic<uint64_t> phase_calls[N_PHASES];
+  std::atomic<uint64_t> phase_nanoseconds[N_PHASES];
+  std::atomic<uint64_t> histogram[latency_buckets];
+
+  unsigned n_steps;
+  std::unique_ptr<atomic_step[]> steps;
+
+public:
+  stats_recorder ();
+
+  /**
+   * @brief Sets the number of concurrent steps and clears every counter
+   */
+  void resize (unsigned steps);
+  void reset ();
+
+  void set_enabled (bool e) { enabled.store(e, std::memory_order_relaxed); }
+  bool active () const { return enabled.load(std::memory_order_relaxed); }
+
+  void record_phase (network_phase phase, uint64_t nanoseconds) {
+    phase_calls[phase].fetch_add(1, std::memory_order_relaxed);
+    phase_nanoseconds[phase].fetch_add(nanoseconds, std::memory_order_relaxed);
+  }
+
+  void record_step (unsigned step, uint64_t nanoseconds, uint64_t wait,
+                    unsigned neurons, unsigned edges);
+
+  void record_latency (uint64_t nanoseconds);
+
+  network_stats snapshot () const;
+};
+
+#endif // NETWORK_STATS_H
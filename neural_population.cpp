@@ -0,0 +1,175 @@
+/*
+ * <one line to give the program's name and a brief idea of what it does.>
+ * Copyright (C) 2018  Daniel Darias Sánchez <dariasteam94@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <algorithm>
+
+#include "neural_population.h"
+#include "concurrent_neural_network.h"
+
+neural_population::neural_population(const std::vector<std::vector<bool>>& vec_graph,
+                                     const std::vector<std::vector<std::vector<double>>>& population_costs,
+                                     unsigned int inps, unsigned int outs, thread_pool* p) :
+                                     individuals(population_costs.size()) {
+  set_thread_pool(p);
+
+  std::vector<unsigned> alive = concurrent_neural_network::find_useful_nodes(vec_graph, inps, outs);
+  unsigned size = alive.size();
+
+  // the weights of the topology are replaced below, any cost matrix will do
+  if (individuals > 0) {
+    topology = compiled_network(vec_graph, population_costs[0], alive, inps, outs);
+  } else {
+    std::vector<std::vector<double>> zero (vec_graph.size(), std::vector<double>(vec_graph.size()));
+    topology = compiled_network(vec_graph, zero, alive, inps, outs);
+  }
+  allocate();
+
+  // gather the weights of each individual in the order of the compiled arrays
+  const unsigned* offsets = topology.predecessor_offsets();
+  const unsigned* sources = topology.predecessors();
+  const unsigned* feedback_offsets = topology.feedback_predecessor_offsets();
+  const unsigned* feedback_sources = topology.feedback_predecessors();
+
+  for (unsigned n = 0; n < individuals; n++) {
+    const std::vector<std::vector<double>>& costs = population_costs[n];
+    for (unsigned j = 0; j < size; j++) {
+      unsigned column = alive[j];
+      set_threshold(n, j, costs[column][column]);
+      for (unsigned k = offsets[j]; k < offsets[j + 1]; k++)
+        set_weight(n, k, costs[alive[sources[k]]][column]);
+      for (unsigned k = feedback_offsets[j]; k < feedback_offsets[j + 1]; k++)
+        set_feedback_weight(n, k, costs[alive[feedback_sources[k]]][column]);
+    }
+  }
+}
+
+neural_population::neural_population(const compiled_network& compiled, unsigned int n_individuals,
+                                     thread_pool* p) :
+                                     topology(compiled),
+                                     individuals(n_individuals) {
+  set_thread_pool(p);
+  allocate();
+}
+
+void neural_population::allocate() {
+  unsigned size = topology.n_neurons();
+
+  stride = (individuals + lane_block - 1) / lane_block * lane_block;
+
+  weights.resize(topology.n_forward_edges() * stride);
+  for (unsigned k = 0; k < topology.n_forward_edges(); k++)
+    std::fill(&weights[k * stride], &weights[k * stride] + individuals,
+              topology.forward_weights()[k]);
+
+  feedback_weights.resize(topology.n_feedback_edges() * stride);
+  for (unsigned k = 0; k < topology.n_feedback_edges(); k++)
+    std::fill(&feedback_weights[k * stride], &feedback_weights[k * stride] + individuals,
+              topology.feedback_connection_weights()[k]);
+
+  thresholds.resize(size * stride);
+  for (unsigned i = 0; i < size; i++)
+    std::fill(&thresholds[i * stride], &thresholds[i * stride] + individuals,
+              topology.neuron_thresholds()[i]);
+
+  activations.assign(size * stride, 0);
+  previous.assign(size * stride, 0);
+  external.assign(topology.n_inputs() * stride, 0);
+}
+
+void neural_population::calculate_individuals(unsigned int begin, unsigned int end) {
+  const kernel_set& simd = topology.kernels();
+  tanh_mode mode = topology.get_tanh_mode();
+  unsigned size = topology.n_neurons();
+  unsigned inputs = topology.n_inputs();
+  unsigned n = end - begin;
+
+  const unsigned* offsets = topology.predecessor_offsets();
+  const unsigned* sources = topology.predecessors();
+  const unsigned* feedback_offsets = topology.feedback_predecessor_offsets();
+  const unsigned* feedback_sources = topology.feedback_predecessors();
+  const double* fan_in = topology.neuron_fan_in();
+
+  for (unsigned i = 0; i < size; i++) {
+    double* values = &activations[i * stride + begin];
+    std::fill(values, values + n, 0.0);
+
+    for (unsigned k = offsets[i]; k < offsets[i + 1]; k++)
+      simd.multiply_accumulate(values, &activations[sources[k] * stride + begin],
+                               &weights[k * stride + begin], n);
+    for (unsigned k = feedback_offsets[i]; k < feedback_offsets[i + 1]; k++)
+      simd.multiply_accumulate(values, &previous[feedback_sources[k] * stride + begin],
+                               &feedback_weights[k * stride + begin], n);
+    if (i < inputs)
+      simd.add(values, &external[i * stride + begin], n);
+
+    if (fan_in[i] == 0)
+      std::fill(values, values + n, 0.0);
+    else
+      simd.activate_lanes(values, n, fan_in[i], &thresholds[i * stride + begin], mode);
+  }
+}
+
+void neural_population::evaluate(std::vector<std::vector<double>>& outputs_values) {
+  // the feedback reads the activations of the last evaluation
+  activations.swap(previous);
+
+  // chunks of whole blocks of individuals, so no two threads write the
+  // same cache line
+  pool->parallel_for(0, stride / lane_block, [&](unsigned begin, unsigned end) {
+    calculate_individuals(begin * lane_block, std::min(end * lane_block, individuals));
+  });
+
+  unsigned size = topology.n_neurons();
+  unsigned outputs = topology.n_outputs();
+  outputs_values.resize(individuals);
+  for (unsigned n = 0; n < individuals; n++) {
+    outputs_values[n].resize(outputs);
+    for (unsigned i = 0; i < outputs; i++)
+      outputs_values[n][i] = activations[(size - outputs + i) * stride + n];
+  }
+}
+
+bool neural_population::operator()(const std::vector<double>& inputs_values,
+                                   std::vector<std::vector<double>>& outputs_values) {
+  unsigned inputs = topology.n_inputs();
+  if (inputs_values.size() != inputs)
+    return false;
+
+  for (unsigned i = 0; i < inputs; i++)
+    std::fill(&external[i * stride], &external[i * stride] + individuals, inputs_values[i]);
+
+  evaluate(outputs_values);
+  return true;
+}
+
+bool neural_population::operator()(const std::vector<std::vector<double>>& inputs_values,
+                                   std::vector<std::vector<double>>& outputs_values) {
+  unsigned inputs = topology.n_inputs();
+  if (inputs_values.size() != individuals)
+    return false;
+  for (auto& row : inputs_values)
+    if (row.size() != inputs)
+      return false;
+
+  for (unsigned n = 0; n < individuals; n++)
+    for (unsigned i = 0; i < inputs; i++)
+      external[i * stride + n] = inputs_values[n][i];
+
+  evaluate(outputs_values);
+  return true;
+}
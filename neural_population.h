@@ -0,0 +1,155 @@
+/*
+ * <one line to give the program's name and a brief idea of what it does.>
+ * Copyright (C) 2018  Daniel Darias Sánchez <dariasteam94@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef NEURAL_POPULATION_H
+#define NEURAL_POPULATION_H
+
+#include <cstdlib>
+#include <new>
+#include <vector>
+
+#include "compiled_network.h"
+#include "thread_pool.h"
+
+/**
+ * @brief Allocator of blocks aligned to a cache line (64 bytes), so the
+ * rows of a #neural_population start at the beginning of a line
+ */
+template <typename T>
+struct cache_line_allocator {
+  typedef T value_type;
+
+  cache_line_allocator () {}
+  template <typename U> cache_line_allocator (const cache_line_allocator<U>&) {}
+
+  T* allocate (std::size_t n) {
+    void* block = nullptr;
+    if (posix_memalign(&block, 64, n * sizeof(T)) != 0)
+      throw std::bad_alloc();
+    return static_cast<T*>(block);
+  }
+  void deallocate (T* block, std::size_t) { std::free(block); }
+};
+
+template <typename T, typename U>
+bool operator== (const cache_line_allocator<T>&, const cache_line_allocator<U>&) { return true; }
+template <typename T, typename U>
+bool operator!= (const cache_line_allocator<T>&, const cache_line_allocator<U>&) { return false; }
+
+/**
+ * @brief Set of individuals that share one pruned and compiled topology and
+ * only differ in their weights and thresholds. Each individual behaves as a
+ * #concurrent_neural_network of its own (with its own recurrent state) and
+ * gives the same results, but the topology is pruned and compiled once and
+ * every evaluation calculates all the individuals in one pass.
+ *
+ * Weights, thresholds and activations are interleaved individual minor
+ * ([edge][individual], [neuron][individual]) so the vector kernels work
+ * across individuals. Every row is padded to a multiple of #lane_block
+ * individuals and the arrays are aligned to a cache line, so a block of
+ * individuals covers whole lines. The pool splits the individuals in whole
+ * blocks, not the neurons, so there are no barriers inside an evaluation
+ * and no two threads write the same line.
+ *
+ */
+class neural_population {
+private:
+  typedef std::vector<double, cache_line_allocator<double>> lane_vector;
+
+  // individuals in a cache line of doubles
+  static const unsigned lane_block = 8;
+
+  compiled_network topology;
+  unsigned individuals;
+  // individuals rounded up to a whole number of blocks: distance between rows
+  unsigned stride;
+
+  lane_vector weights;
+  lane_vector feedback_weights;
+  lane_vector thresholds;
+
+  // current and previous timestep, swapped before each evaluation
+  lane_vector activations;
+  lane_vector previous;
+  lane_vector external;
+
+  thread_pool* pool;
+
+  /**
+   * @brief Copies the topology weights to every individual and sizes the
+   * evaluation buffers
+   */
+  void allocate ();
+
+  /**
+   * @brief Calculates every neuron, in index order, for the individuals in
+   * [begin, end)
+   */
+  void calculate_individuals (unsigned begin, unsigned end);
+
+  void evaluate (std::vector<std::vector<double>>& outputs_values);
+
+public:
+  /**
+   * @brief Prunes the graph once and takes the weights and thresholds of each
+   * individual from its own cost matrix
+   *
+   * @param vec_graph p_vec_graph: adjacency matrix shared by every individual
+   * @param population_costs p_population_costs: one cost matrix per individual
+   */
+  neural_population (const std::vector<std::vector<bool>>& vec_graph,
+                     const std::vector<std::vector<std::vector<double>>>& population_costs,
+                     unsigned inps, unsigned outs, thread_pool* pool = nullptr);
+
+  /**
+   * @brief Every individual starts with the weights of the topology
+   */
+  neural_population (const compiled_network& compiled, unsigned n_individuals,
+                     thread_pool* pool = nullptr);
+
+  /**
+   * @brief Evaluates every individual with the same inputs
+   *
+   * @param outputs_values p_outputs_values: one row of outputs per individual
+   */
+  bool operator () (const std::vector<double>& inputs_values,
+                    std::vector<std::vector<double>>& outputs_values);
+
+  /**
+   * @brief Evaluates every individual with its own inputs, one row each
+   */
+  bool operator () (const std::vector<std::vector<double>>& inputs_values,
+                    std::vector<std::vector<double>>& outputs_values);
+
+  unsigned size () const { return individuals; }
+  const compiled_network& get_topology () const { return topology; }
+
+  /**
+   * @brief Edges are numbered as in the compiled topology: forward edges in
+   * the order of #compiled_network::predecessors and feedback edges in the
+   * order of #compiled_network::feedback_predecessors
+   */
+  void set_weight (unsigned individual, unsigned edge, double w) { weights[edge * stride + individual] = w; }
+  void set_feedback_weight (unsigned individual, unsigned edge, double w) { feedback_weights[edge * stride + individual] = w; }
+  void set_threshold (unsigned individual, unsigned neuron, double t) { thresholds[neuron * stride + individual] = t; }
+
+  void set_tanh_mode (tanh_mode mode) { topology.set_tanh_mode(mode); }
+  void set_thread_pool (thread_pool* p) { pool = (p != nullptr) ? p : &thread_pool::shared(); }
+};
+
+#endif // NEURAL_POPULATION_H
@@ -0,0 +1,207 @@
+/*
+ * <one line to give the program's name and a brief idea of what it does.>
+ * Copyright (C) 2018  Daniel Darias Sánchez <dariasteam94@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <map>
+#include <sstream>
+#include <string>
+#include <thread>
+
+#include "numa_placement.h"
+
+#ifdef __linux__
+#include <dlfcn.h>
+#include <pthread.h>
+#include <sched.h>
+#include <unistd.h>
+#endif
+
+namespace {
+
+// the functions of libnuma that are used, resolved with dlsym
+struct libnuma_api {
+  void* handle;
+  int (*available) ();
+  int (*node_of_cpu) (int);
+  void* (*alloc_onnode) (size_t, int);
+  void (*free) (void*, size_t);
+};
+
+libnuma_api load_libnuma() {
+  libnuma_api api;
+  std::memset(&api, 0, sizeof(api));
+#ifdef __linux__
+  const char* names[] = {"libnuma.so.1", "libnuma.so"};
+  for (const char* name : names) {
+    api.handle = dlopen(name, RTLD_NOW | RTLD_LOCAL);
+    if (api.handle)
+      break;
+  }
+  if (!api.handle)
+    return api;
+
+  api.available = reinterpret_cast<int (*) ()>(dlsym(api.handle, "numa_available"));
+  api.node_of_cpu = reinterpret_cast<int (*) (int)>(dlsym(api.handle, "numa_node_of_cpu"));
+  api.alloc_onnode = reinterpret_cast<void* (*) (size_t, int)>(dlsym(api.handle, "numa_alloc_onnode"));
+  api.free = reinterpret_cast<void (*) (void*, size_t)>(dlsym(api.handle, "numa_free"));
+
+  // the library is there but the kernel has no NUMA support
+  if (!api.available || !api.node_of_cpu || !api.alloc_onnode || !api.free || api.available() < 0) {
+    dlclose(api.handle);
+    std::memset(&api, 0, sizeof(api));
+  }
+#endif
+  return api;
+}
+
+const libnuma_api& libnuma() {
+  static libnuma_api api = load_libnuma();
+  return api;
+}
+
+// sysfs lists, like "0-3,8,10-11"
+std::vector<unsigned> parse_cpu_list(const std::string& text) {
+  std::vector<unsigned> cpus;
+  std::stringstream stream (text);
+  std::string range;
+  while (std::getline(stream, range, ',')) {
+    unsigned first, last;
+    char dash;
+    std::stringstream bounds (range);
+    if (!(bounds >> first))
+      continue;
+    if (!(bounds >> dash >> last))
+      last = first;
+    for (unsigned cpu = first; cpu <= last; cpu++)
+      cpus.push_back(cpu);
+  }
+  return cpus;
+}
+
+std::string read_line(const std::string& filename) {
+  std::ifstream file (filename);
+  std::string line;
+  std::getline(file, line);
+  return line;
+}
+
+// CPUs of the affinity mask of the process
+std::vector<unsigned> allowed_cpus() {
+  std::vector<unsigned> cpus;
+#ifdef __linux__
+  cpu_set_t set;
+  CPU_ZERO(&set);
+  if (sched_getaffinity(0, sizeof(set), &set) == 0)
+    for (unsigned cpu = 0; cpu < CPU_SETSIZE; cpu++)
+      if (CPU_ISSET(cpu, &set))
+        cpus.push_back(cpu);
+#endif
+  if (cpus.empty())
+    for (unsigned cpu = 0; cpu < std::max(1u, std::thread::hardware_concurrency()); cpu++)
+      cpus.push_back(cpu);
+  return cpus;
+}
+
+long page_size() {
+#ifdef __linux__
+  return sysconf(_SC_PAGESIZE);
+#else
+  return 4096;
+#endif
+}
+
+}
+
+bool pin_current_thread(const std::vector<unsigned>& cpus) {
+#ifdef __linux__
+  cpu_set_t set;
+  CPU_ZERO(&set);
+  for (unsigned cpu : cpus)
+    if (cpu < CPU_SETSIZE)
+      CPU_SET(cpu, &set);
+  return CPU_COUNT(&set) > 0 && pthread_setaffinity_np(pthread_self(), sizeof(set), &set) == 0;
+#else
+  return false;
+#endif
+}
+
+numa_topology::numa_topology() : library(libnuma().handle != nullptr) {
+  std::vector<unsigned> allowed = allowed_cpus();
+  std::map<int, std::vector<unsigned>> by_node;
+
+  if (library) {
+    for (unsigned cpu : allowed)
+      by_node[std::max(0, libnuma().node_of_cpu(cpu))].push_back(cpu);
+  } else {
+    for (unsigned node : parse_cpu_list(read_line("/sys/devices/system/node/online"))) {
+      std::string list = read_line("/sys/devices/system/node/node" + std::to_string(node) + "/cpulist");
+      for (unsigned cpu : parse_cpu_list(list))
+        if (std::find(allowed.begin(), allowed.end(), cpu) != allowed.end())
+          by_node[node].push_back(cpu);
+    }
+  }
+
+  for (const auto& node : by_node) {
+    if (!node.second.empty()) {
+      ids.push_back(node.first);
+      nodes.push_back(node.second);
+    }
+  }
+  if (nodes.empty()) {
+    ids.push_back(0);
+    nodes.push_back(allowed);
+  }
+}
+
+const numa_topology& numa_topology::system() {
+  static numa_topology topology;
+  return topology;
+}
+
+void numa_topology::run_on(unsigned int node, const std::function<void ()>& f) const {
+  std::thread placed ([&] {
+    pin_current_thread(cpus(node));
+    f();
+  });
+  placed.join();
+}
+
+std::shared_ptr<char> numa_topology::allocate(uint64_t size, unsigned int node) const {
+  size = std::max<uint64_t>(size, 1);
+
+  if (library) {
+    void* block = libnuma().alloc_onnode(size, ids[node]);
+    if (block)
+      return std::shared_ptr<char>(static_cast<char*>(block),
+                                   [size](char* b) { libnuma().free(b, size); });
+  }
+
+  // first touch
+  std::shared_ptr<char> block;
+  run_on(node, [&] {
+    void* memory = nullptr;
+    if (posix_memalign(&memory, page_size(), size) != 0)
+      return;
+    std::memset(memory, 0, size);
+    block.reset(static_cast<char*>(memory), [](char* b) { std::free(b); });
+  });
+  return block;
+}
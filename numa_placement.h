@@ -0,0 +1,77 @@
+/*
+ * <one line to give the program's name and a brief idea of what it does.>
+ * Copyright (C) 2018  Daniel Darias Sánchez <dariasteam94@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef NUMA_PLACEMENT_H
+#define NUMA_PLACEMENT_H
+
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <vector>
+
+/**
+ * @brief Pins the calling thread to the given CPUs
+ *
+ * @return bool false if the affinity could not be set (not Linux, no
+ * permission or no valid CPU)
+ */
+bool pin_current_thread (const std::vector<unsigned>& cpus);
+
+/**
+ * @brief NUMA nodes of the machine and the CPUs of each one the process is
+ * allowed to run on. Nodes without such CPUs are left out, so node k of the
+ * topology is not always node k of the system (see #node_id).
+ *
+ * libnuma is loaded at runtime with dlopen; memory is then bound to a node
+ * with numa_alloc_onnode. Without it the nodes are read from sysfs and
+ * memory is placed by first touch, zeroing it from a thread pinned to the
+ * node. If neither is available the whole machine is a single node.
+ */
+class numa_topology {
+private:
+  std::vector<std::vector<unsigned>> nodes;
+  std::vector<int> ids;
+  bool library;
+
+  numa_topology ();
+
+public:
+  /**
+   * @brief Topology of this machine, detected the first time it is used
+   */
+  static const numa_topology& system ();
+
+  unsigned n_nodes () const { return nodes.size(); }
+  const std::vector<unsigned>& cpus (unsigned node) const { return nodes[node]; }
+  int node_id (unsigned node) const { return ids[node]; }
+  bool has_libnuma () const { return library; }
+
+  /**
+   * @brief Runs f in a thread pinned to the CPUs of node and waits for it,
+   * so the memory f touches first is placed in the node
+   */
+  void run_on (unsigned node, const std::function<void ()>& f) const;
+
+  /**
+   * @brief Zeroed block of size bytes, aligned to a page, in the memory of
+   * node. It is released with the last copy of the pointer.
+   */
+  std::shared_ptr<char> allocate (uint64_t size, unsigned node) const;
+};
+
+#endif // NUMA_PLACEMENT_H
@@ -0,0 +1,113 @@
+/*
+ * <one line to give the program's name and a brief idea of what it does.>
+ * Copyright (C) 2018  Daniel Darias Sánchez <dariasteam94@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <algorithm>
+#include <cstring>
+
+#include "perf_counters.h"
+
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+static int open_event (perf_event_kind event, int group) {
+  perf_event_attr attr;
+  std::memset(&attr, 0, sizeof(attr));
+  attr.size = sizeof(attr);
+  attr.exclude_kernel = 1;
+  attr.exclude_hv = 1;
+  attr.read_format = PERF_FORMAT_GROUP;
+
+  switch (event) {
+    case PERF_CYCLES:
+      attr.type = PERF_TYPE_HARDWARE;
+      attr.config = PERF_COUNT_HW_CPU_CYCLES;
+      break;
+    case PERF_INSTRUCTIONS:
+      attr.type = PERF_TYPE_HARDWARE;
+      attr.config = PERF_COUNT_HW_INSTRUCTIONS;
+      break;
+    case PERF_L1D_MISSES:
+      attr.type = PERF_TYPE_HW_CACHE;
+      attr.config = PERF_COUNT_HW_CACHE_L1D | (PERF_COUNT_HW_CACHE_OP_READ << 8) |
+                    (PERF_COUNT_HW_CACHE_RESULT_MISS << 16);
+      break;
+    case PERF_LLC_MISSES:
+      attr.type = PERF_TYPE_HARDWARE;
+      attr.config = PERF_COUNT_HW_CACHE_MISSES;
+      break;
+    default:
+      attr.type = PERF_TYPE_HARDWARE;
+      attr.config = PERF_COUNT_HW_BRANCH_MISSES;
+      break;
+  }
+
+  return syscall(__NR_perf_event_open, &attr, 0, -1, group, 0);
+}
+#endif
+
+perf_counters::perf_counters() : leader(-1) {
+#ifdef __linux__
+  for (unsigned e = 0; e < N_PERF_EVENTS; e++) {
+    perf_event_kind event = perf_event_kind(e);
+    int fd = open_event(event, leader);
+    if (fd < 0)
+      continue;
+    if (leader < 0)
+      leader = fd;
+    descriptors.push_back(fd);
+    members.push_back(event);
+  }
+#endif
+}
+
+perf_counters::~perf_counters() {
+#ifdef __linux__
+  for (int fd : descriptors)
+    close(fd);
+#endif
+}
+
+bool perf_counters::available(perf_event_kind event) const {
+  return std::find(members.begin(), members.end(), event) != members.end();
+}
+
+void perf_counters::read(perf_sample& sample) const {
+  std::memset(&sample, 0, sizeof(sample));
+#ifdef __linux__
+  if (leader < 0)
+    return;
+  // { nr, value[nr] }
+  uint64_t values[N_PERF_EVENTS + 1];
+  ssize_t bytes = ::read(leader, values, sizeof(values));
+  if (bytes < ssize_t(sizeof(uint64_t)))
+    return;
+  unsigned n = std::min<uint64_t>(values[0], members.size());
+  for (unsigned k = 0; k < n; k++)
+    sample.counts[members[k]] = values[k + 1];
+#endif
+}
+
+perf_sample perf_difference(const perf_sample& after, const perf_sample& before) {
+  perf_sample difference;
+  for (unsigned e = 0; e < N_PERF_EVENTS; e++)
+    difference.counts[e] = after.counts[e] - before.counts[e];
+  return difference;
+}
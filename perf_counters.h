@@ -0,0 +1,98 @@
+/*
+ * <one line to give the program's name and a brief idea of what it does.>
+ * Copyright (C) 2018  Daniel Darias Sánchez <dariasteam94@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef PERF_COUNTERS_H
+#define PERF_COUNTERS_H
+
+#include <cstdint>
+#include <vector>
+
+/**
+ * @brief Hardware events counted by #perf_counters
+ */
+enum perf_event_kind {
+  PERF_CYCLES, PERF_INSTRUCTIONS, PERF_L1D_MISSES, PERF_LLC_MISSES, PERF_BRANCH_MISSES,
+  N_PERF_EVENTS
+};
+
+struct perf_sample {
+  uint64_t counts[N_PERF_EVENTS];
+};
+
+struct perf_step_report {
+  perf_sample counters;
+  unsigned neurons;
+  unsigned edges;
+};
+
+/**
+ * @brief Counters of one profiled evaluation, in total and by concurrent
+ * step. Events that could not be opened are reported as 0 and flagged in
+ * available.
+ */
+struct perf_report {
+  bool available[N_PERF_EVENTS];
+  perf_sample total;
+  unsigned edges;
+  std::vector<perf_step_report> steps;
+
+  /**
+   * @brief Events of the whole evaluation per connection read, 0 if the
+   * event is not available
+   */
+  double per_edge (perf_event_kind event) const {
+    return (available[event] && edges > 0) ? double(total.counts[event]) / edges : 0;
+  }
+};
+
+/**
+ * @brief Group of hardware counters of the calling thread opened with
+ * perf_event_open (user space only). Counting starts when it is built, and
+ * #read returns the accumulated values, so an interval is the difference of
+ * two reads. The counters only see the thread that built the object.
+ *
+ * Events the kernel or the hardware does not provide (no PMU in a virtual
+ * machine, perf_event_paranoid too high, not Linux) are skipped; if none
+ * can be opened every read returns 0.
+ */
+class perf_counters {
+private:
+  int leader;
+  std::vector<int> descriptors;
+  // event of each member of the group, in the order they are read
+  std::vector<perf_event_kind> members;
+
+public:
+  perf_counters ();
+  ~perf_counters ();
+
+  perf_counters (const perf_counters&) = delete;
+  perf_counters& operator= (const perf_counters&) = delete;
+
+  bool available (perf_event_kind event) const;
+  bool any () const { return !members.empty(); }
+
+  void read (perf_sample& sample) const;
+};
+
+/**
+ * @brief after - before, event by event
+ */
+perf_sample perf_difference (const perf_sample& after, const perf_sample& before);
+
+#endif // PERF_COUNTERS_H
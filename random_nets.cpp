@@ -0,0 +1,80 @@
+/*
+ * <one line to give the program's name and a brief idea of what it does.>
+ * Copyright (C) 2018  Daniel Darias Sánchez <dariasteam94@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <cstdlib>
+
+#include "random_nets.h"
+
+static double uniform () {
+  return double(std::rand()) / (double(RAND_MAX) + 1);
+}
+
+static double random_cost () {
+  return double(-1000 + (std::rand() % 2000)) / 1000;
+}
+
+std::vector<std::vector<bool>> random_graph_generator(unsigned N, double density, double feedback_ratio) {
+  std::vector<std::vector<bool>> vec;
+  unsigned size = N + 1;
+  vec.resize(size);
+  for (unsigned i = 0; i < size; i++) {
+    vec[i].resize(size);
+    for (unsigned j = 0; j < size; j++) {
+      double probability = 2 * density * ((i > j) ? feedback_ratio : 1 - feedback_ratio);
+      vec[i][j] = (i != j) && uniform() < probability;
+    }
+  }
+  return vec;
+}
+
+std::vector<std::vector<double>> random_costs_generator(unsigned N) {
+  std::vector<std::vector<double>> vec;
+  unsigned size = N + 1;
+  vec.resize(size);
+  for (unsigned i = 0; i < size; i++) {
+    vec[i].resize(size);
+    for (unsigned j = 0; j < size; j++)
+      vec[i][j] = random_cost();
+  }
+  return vec;
+}
+
+void random_sparse_generator(unsigned N, double fan_in, double feedback_ratio,
+                             std::vector<double>& thresholds, std::vector<network_edge>& edges) {
+  unsigned size = N + 1;
+  thresholds.resize(size);
+  edges.clear();
+  edges.reserve(size * fan_in);
+  for (unsigned j = 0; j < size; j++) {
+    thresholds[j] = random_cost();
+
+    // between floor and ceil of fan_in connections, fan_in on average
+    unsigned count = fan_in;
+    if (uniform() < fan_in - count)
+      count++;
+
+    for (unsigned k = 0; k < count; k++) {
+      // forward sources are below j and feedback sources above it
+      bool feedback = (j == 0) || (j + 1 < size && uniform() < feedback_ratio);
+      unsigned from = feedback ? j + 1 + unsigned(uniform() * (size - j - 1))
+                               : unsigned(uniform() * j);
+      if (from < size && from != j)
+        edges.push_back(network_edge {from, j, random_cost()});
+    }
+  }
+}
@@ -0,0 +1,56 @@
+/*
+ * <one line to give the program's name and a brief idea of what it does.>
+ * Copyright (C) 2018  Daniel Darias Sánchez <dariasteam94@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef RANDOM_NETS_H
+#define RANDOM_NETS_H
+
+#include <vector>
+
+#include "net_io.h"
+
+/**
+ * @brief Random adjacency matrix of N + 1 neurons, drawn with std::rand.
+ *
+ * @param density p_density: probability of a connection between two
+ * neurons, in either direction
+ * @param feedback_ratio p_feedback_ratio: fraction of the connections that
+ * are feedback (lower triangle). With the defaults every cell is set with
+ * probability 1/15, as the original generator did.
+ */
+std::vector<std::vector<bool>> random_graph_generator (unsigned N, double density = 1.0 / 15,
+                                                       double feedback_ratio = 0.5);
+
+/**
+ * @brief Random costs in [-1, 1) with a resolution of 0.001, for N + 1
+ * neurons
+ */
+std::vector<std::vector<double>> random_costs_generator (unsigned N);
+
+/**
+ * @brief Random sparse net of N + 1 neurons, drawn with std::rand, for sizes
+ * whose matrices would not fit in memory. Every neuron gets fan_in
+ * connections on average, from sources chosen uniformly among the other
+ * neurons, and weights and thresholds as #random_costs_generator.
+ *
+ * @param feedback_ratio p_feedback_ratio: fraction of the connections that
+ * are feedback
+ */
+void random_sparse_generator (unsigned N, double fan_in, double feedback_ratio,
+                              std::vector<double>& thresholds, std::vector<network_edge>& edges);
+
+#endif // RANDOM_NETS_H
@@ -0,0 +1,49 @@
+/*
+ * <one line to give the program's name and a brief idea of what it does.>
+ * Copyright (C) 2018  Daniel Darias Sánchez <dariasteam94@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "reduced_precision.h"
+
+const float* tanh_table() {
+  static const std::vector<float> table = [] {
+    std::vector<float> values (tanh_table_size + 1);
+    for (unsigned k = 0; k <= tanh_table_size; k++)
+      values[k] = std::tanh(-tanh_table_range + k * (2.0 * tanh_table_range / tanh_table_size));
+    return values;
+  }();
+  return table.data();
+}
+
+std::vector<double> calibrate_activations(const compiled_network& net,
+                                          const std::vector<std::vector<double>>& samples) {
+  std::vector<double> ranges (net.n_neurons(), 0);
+  if (samples.empty())
+    return ranges;
+
+  evaluation_context context (net);
+  for (auto& inputs_values : samples) {
+    if (inputs_values.size() != net.n_inputs())
+      continue;
+    net.propagate_feedback(context);
+    net.set_inputs(context, inputs_values);
+    for (unsigned i = 0; i < net.n_neurons(); i++) {
+      net.calculate_neuron(context, i);
+      ranges[i] = std::max(ranges[i], std::abs(context.value(i)));
+    }
+  }
+  return ranges;
+}
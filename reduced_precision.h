@@ -0,0 +1,309 @@
+/*
+ * <one line to give the program's name and a brief idea of what it does.>
+ * Copyright (C) 2018  Daniel Darias Sánchez <dariasteam94@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef REDUCED_PRECISION_H
+#define REDUCED_PRECISION_H
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <limits>
+#include <vector>
+
+#include "compiled_network.h"
+
+/**
+ * @brief Table of tanh used by the quantised nets: tanh_table_size + 1
+ * samples evenly spaced over [-tanh_table_range, tanh_table_range]. Linear
+ * interpolation between them has an absolute error below 1e-5, under the
+ * resolution of an int16 activation.
+ */
+const unsigned tanh_table_size = 2048;
+const float tanh_table_range = 8;
+
+const float* tanh_table ();
+
+inline float table_tanh (float x) {
+  const float* table = tanh_table();
+  float t = (x + tanh_table_range) * (tanh_table_size / (2 * tanh_table_range));
+  t = std::min(float(tanh_table_size), std::max(0.0f, t));
+  unsigned k = std::min(unsigned(t), tanh_table_size - 1);
+  return table[k] + (table[k + 1] - table[k]) * (t - k);
+}
+
+/**
+ * @brief Compiled net evaluated with another floating point type, usually
+ * float. Indices are shared with the compiled net; weights, thresholds and
+ * state are converted to T, so the evaluation moves half the bytes of the
+ * double one. Neurons are calculated in index order on the calling thread,
+ * with the same double buffered recurrent state as #evaluation_context.
+ */
+template <typename T>
+class typed_network {
+private:
+  compiled_network topology;
+
+  std::vector<T> weights;
+  std::vector<T> feedback_weights;
+  std::vector<T> thresholds;
+  std::vector<T> fan_in;
+
+  std::vector<T> activations;
+  std::vector<T> previous;
+  std::vector<T> external;
+
+public:
+  explicit typed_network (const compiled_network& net) :
+                          topology(net),
+                          weights(net.forward_weights(), net.forward_weights() + net.n_forward_edges()),
+                          feedback_weights(net.feedback_connection_weights(),
+                                           net.feedback_connection_weights() + net.n_feedback_edges()),
+                          thresholds(net.neuron_thresholds(), net.neuron_thresholds() + net.n_neurons()),
+                          fan_in(net.neuron_fan_in(), net.neuron_fan_in() + net.n_neurons()),
+                          activations(net.n_neurons(), 0),
+                          previous(net.n_neurons(), 0),
+                          external(net.n_inputs(), 0) {}
+
+  bool operator () (const std::vector<double>& inputs_values, std::vector<double>& outputs_values) {
+    unsigned size = topology.n_neurons();
+    unsigned inputs = topology.n_inputs();
+    unsigned outputs = topology.n_outputs();
+    if (inputs_values.size() != inputs)
+      return false;
+
+    tanh_mode mode = topology.get_tanh_mode();
+
+    activations.swap(previous);
+    for (unsigned i = 0; i < inputs; i++)
+      external[i] = inputs_values[i];
+
+    for (unsigned i = 0; i < size; i++)
+      activations[i] = topology.template update_neuron<T, T>(
+        i, activations.data(), previous.data(), weights.data(), feedback_weights.data(),
+        external.data(), fan_in.data(), thresholds.data(),
+        [](T sum, unsigned) { return sum; },
+        [mode](T x, unsigned) { return (mode == tanh_mode::fast) ? T(fast_tanh(x)) : std::tanh(x); });
+
+    outputs_values.resize(outputs);
+    for (unsigned i = 0; i < outputs; i++)
+      outputs_values[i] = activations[size - outputs + i];
+    return true;
+  }
+
+  void reset () {
+    std::fill(activations.begin(), activations.end(), T(0));
+    std::fill(previous.begin(), previous.end(), T(0));
+  }
+
+  /**
+   * @brief Bytes of weights, thresholds and state read by an evaluation
+   */
+  std::size_t value_bytes () const {
+    return sizeof(T) * (weights.size() + feedback_weights.size() + thresholds.size() +
+                        fan_in.size() + activations.size() + previous.size());
+  }
+};
+
+template <typename Q> struct quantization_traits;
+template <> struct quantization_traits<int16_t> { typedef int64_t accumulator; };
+template <> struct quantization_traits<int8_t> { typedef int32_t accumulator; };
+
+/**
+ * @brief Ranges of the activations of a net, measured by evaluating it
+ * (as a sequence, from a new state) over some sample inputs
+ *
+ * @return std::vector< double > max |activation| of every neuron
+ */
+std::vector<double> calibrate_activations (const compiled_network& net,
+                                           const std::vector<std::vector<double>>& samples);
+
+/**
+ * @brief Compiled net evaluated in fixed point, with int16 or int8
+ * activations and weights.
+ *
+ * The activation of neuron i is stored as round(a * S_i), where the scale
+ * S_i maps the largest activation seen during the calibration (with some
+ * headroom) to the largest integer. Weights absorb the scale of their
+ * source and are quantised per destination neuron, so the weighted sum is
+ * accumulated in integers and converted to float once per neuron. The
+ * activation function is #table_tanh in both tanh modes.
+ *
+ * External inputs, thresholds and fan-in stay in float.
+ */
+template <typename Q>
+class quantized_network {
+private:
+  typedef typename quantization_traits<Q>::accumulator accumulator;
+
+  compiled_network topology;
+
+  std::vector<Q> weights;
+  std::vector<Q> feedback_weights;
+  std::vector<float> inverse_weight_scale;
+  std::vector<float> activation_scale;
+  std::vector<float> thresholds;
+  std::vector<float> fan_in;
+
+  std::vector<Q> activations;
+  std::vector<Q> previous;
+  std::vector<float> external;
+
+  static Q quantize (double value) {
+    const double limit = std::numeric_limits<Q>::max();
+    return Q(std::max(-limit, std::min(limit, std::round(value))));
+  }
+
+public:
+  /**
+   * @param samples p_samples: inputs used to calibrate the scales, see
+   * #calibrate_activations. The scales assume the whole [-1, 1] range if
+   * empty.
+   */
+  quantized_network (const compiled_network& net, const std::vector<std::vector<double>>& samples) :
+                     topology(net),
+                     weights(net.n_forward_edges()),
+                     feedback_weights(net.n_feedback_edges()),
+                     inverse_weight_scale(net.n_neurons()),
+                     activation_scale(net.n_neurons()),
+                     thresholds(net.neuron_thresholds(), net.neuron_thresholds() + net.n_neurons()),
+                     fan_in(net.neuron_fan_in(), net.neuron_fan_in() + net.n_neurons()),
+                     activations(net.n_neurons(), 0),
+                     previous(net.n_neurons(), 0),
+                     external(net.n_inputs(), 0) {
+
+    unsigned size = net.n_neurons();
+    const double limit = std::numeric_limits<Q>::max();
+    const unsigned* offsets = net.predecessor_offsets();
+    const unsigned* sources = net.predecessors();
+    const unsigned* feedback_offsets = net.feedback_predecessor_offsets();
+    const unsigned* feedback_sources = net.feedback_predecessors();
+
+    std::vector<double> ranges = calibrate_activations(net, samples);
+    std::vector<double> scales (size);
+    for (unsigned i = 0; i < size; i++) {
+      // 10% of headroom for inputs not seen during the calibration
+      double range = (ranges[i] > 0) ? std::min(1.0, ranges[i] * 1.1) : 1.0;
+      scales[i] = limit / range;
+      activation_scale[i] = scales[i];
+    }
+
+    // weight per unit of the quantised source, then quantised per neuron
+    for (unsigned i = 0; i < size; i++) {
+      double largest = 0;
+      for (unsigned k = offsets[i]; k < offsets[i + 1]; k++)
+        largest = std::max(largest, std::abs(net.forward_weights()[k] / scales[sources[k]]));
+      for (unsigned k = feedback_offsets[i]; k < feedback_offsets[i + 1]; k++)
+        largest = std::max(largest, std::abs(net.feedback_connection_weights()[k] / scales[feedback_sources[k]]));
+
+      double weight_scale = (largest > 0) ? limit / largest : 1.0;
+      inverse_weight_scale[i] = 1 / weight_scale;
+      for (unsigned k = offsets[i]; k < offsets[i + 1]; k++)
+        weights[k] = quantize(net.forward_weights()[k] / scales[sources[k]] * weight_scale);
+      for (unsigned k = feedback_offsets[i]; k < feedback_offsets[i + 1]; k++)
+        feedback_weights[k] = quantize(net.feedback_connection_weights()[k] /
+                                       scales[feedback_sources[k]] * weight_scale);
+    }
+  }
+
+  bool operator () (const std::vector<double>& inputs_values, std::vector<double>& outputs_values) {
+    unsigned size = topology.n_neurons();
+    unsigned inputs = topology.n_inputs();
+    unsigned outputs = topology.n_outputs();
+    if (inputs_values.size() != inputs)
+      return false;
+
+    activations.swap(previous);
+    for (unsigned i = 0; i < inputs; i++)
+      external[i] = inputs_values[i];
+
+    // the integer sum is converted to float once per neuron
+    for (unsigned i = 0; i < size; i++)
+      activations[i] = topology.template update_neuron<Q, accumulator>(
+        i, activations.data(), previous.data(), weights.data(), feedback_weights.data(),
+        external.data(), fan_in.data(), thresholds.data(),
+        [this](accumulator sum, unsigned j) { return float(sum) * inverse_weight_scale[j]; },
+        [this](float x, unsigned j) { return quantize(table_tanh(x) * activation_scale[j]); });
+
+    outputs_values.resize(outputs);
+    for (unsigned i = 0; i < outputs; i++)
+      outputs_values[i] = activations[size - outputs + i] / activation_scale[size - outputs + i];
+    return true;
+  }
+
+  void reset () {
+    std::fill(activations.begin(), activations.end(), Q(0));
+    std::fill(previous.begin(), previous.end(), Q(0));
+  }
+
+  /**
+   * @brief Bytes of weights and state read by an evaluation
+   */
+  std::size_t value_bytes () const {
+    return sizeof(Q) * (weights.size() + feedback_weights.size() + activations.size() + previous.size()) +
+           sizeof(float) * (inverse_weight_scale.size() + activation_scale.size() +
+                            thresholds.size() + fan_in.size());
+  }
+};
+
+/**
+ * @brief Deviation of a reduced precision net from the double one
+ */
+struct precision_report {
+  double max_deviation;
+  double mean_deviation;
+  unsigned values;
+};
+
+/**
+ * @brief Evaluates the reduced net and the double reference over the same
+ * sequence of test inputs, both from a new state, and compares every output.
+ * The reduced net is reset before and after.
+ */
+template <typename N>
+precision_report measure_deviation (N& reduced, const compiled_network& reference,
+                                    const std::vector<std::vector<double>>& test_inputs) {
+  precision_report report {0, 0, 0};
+  evaluation_context context (reference);
+  std::vector<double> expected;
+  std::vector<double> obtained;
+
+  reduced.reset();
+  for (auto& inputs_values : test_inputs) {
+    if (inputs_values.size() != reference.n_inputs())
+      continue;
+    reference.propagate_feedback(context);
+    reference.set_inputs(context, inputs_values);
+    for (unsigned i = 0; i < reference.n_neurons(); i++)
+      reference.calculate_neuron(context, i);
+    reference.get_outputs(context, expected);
+    reduced(inputs_values, obtained);
+
+    for (unsigned i = 0; i < expected.size(); i++) {
+      double deviation = std::abs(expected[i] - obtained[i]);
+      report.max_deviation = std::max(report.max_deviation, deviation);
+      report.mean_deviation += deviation;
+      report.values++;
+    }
+  }
+  if (report.values > 0)
+    report.mean_deviation /= report.values;
+  reduced.reset();
+  return report;
+}
+
+#endif // REDUCED_PRECISION_H
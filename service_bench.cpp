@@ -0,0 +1,232 @@
+/*
+ * <one line to give the program's name and a brief idea of what it does.>
+ * Copyright (C) 2018  Daniel Darias Sánchez <dariasteam94@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "inference_service.h"
+#include "random_nets.h"
+
+/**
+ * Load test of #inference_service on one machine: a number of client threads
+ * send bursts of requests to a random net and the latency of every request
+ * and the total throughput are measured, for every combination of
+ *
+ *   concurrent_service_bench [--size N] [--density D] [--clients list]
+ *                            [--burst N] [--requests N] [--max-batch list]
+ *                            [--max-wait list of microseconds]
+ *                            [--socket path]
+ *
+ * The "direct" rows are the baseline, every client evaluating its own
+ * requests one by one with its own context. With --socket the clients of
+ * the service connect through a Unix domain socket at path instead of
+ * calling #inference_service::submit, and send one request at a time.
+ */
+
+struct service_options {
+  unsigned size = 1000;
+  double density = 1.0 / 15;
+  std::vector<unsigned> clients {1, 4, 16};
+  unsigned burst = 8;
+  unsigned requests = 2000;
+  std::vector<unsigned> max_batch {16, 64};
+  std::vector<unsigned> max_wait {100, 1000};
+  std::string socket;
+};
+
+typedef std::chrono::steady_clock bench_clock;
+
+template <class T>
+static std::vector<T> parse_list (const std::string& text) {
+  std::vector<T> values;
+  std::stringstream stream (text);
+  std::string item;
+  while (std::getline(stream, item, ',')) {
+    std::stringstream value (item);
+    T v;
+    if (value >> v)
+      values.push_back(v);
+  }
+  return values;
+}
+
+static bool parse_options (int argc, char **argv, service_options& options) {
+  for (int k = 1; k < argc; k++) {
+    std::string option = argv[k];
+    if (k + 1 >= argc)
+      return false;
+    std::string value = argv[++k];
+
+    if (option == "--size")
+      options.size = std::atoi(value.c_str());
+    else if (option == "--density")
+      options.density = std::atof(value.c_str());
+    else if (option == "--clients")
+      options.clients = parse_list<unsigned>(value);
+    else if (option == "--burst")
+      options.burst = std::max(1, std::atoi(value.c_str()));
+    else if (option == "--requests")
+      options.requests = std::max(1, std::atoi(value.c_str()));
+    else if (option == "--max-batch")
+      options.max_batch = parse_list<unsigned>(value);
+    else if (option == "--max-wait")
+      options.max_wait = parse_list<unsigned>(value);
+    else if (option == "--socket")
+      options.socket = value;
+    else
+      return false;
+  }
+  return options.size > 5 && !options.clients.empty();
+}
+
+static double percentile (std::vector<double>& values, double p) {
+  if (values.empty())
+    return 0;
+  std::sort(values.begin(), values.end());
+  return values[std::min<size_t>(values.size() - 1, p * values.size())];
+}
+
+static std::vector<double> client_inputs (unsigned client, unsigned k) {
+  return std::vector<double> {(client % 5) / 5.0, (k % 7) / 7.0, ((client + k) % 3) / 3.0};
+}
+
+/**
+ * @brief Runs the clients, each one calling send with its requests, and
+ * prints the latency and throughput rows
+ *
+ * @param send p_send: evaluates the requests [first, first + count) of a
+ * client and stores the latency of each one in microseconds
+ */
+template <class sender>
+static void run_clients (const service_options& options, unsigned clients, const std::string& label,
+                         sender send) {
+  unsigned per_client = std::max(1u, options.requests / clients);
+  std::vector<std::vector<double>> latencies (clients);
+  std::vector<std::thread> threads;
+
+  auto begin = bench_clock::now();
+  for (unsigned c = 0; c < clients; c++) {
+    threads.emplace_back([&, c] {
+      for (unsigned k = 0; k < per_client; k += options.burst)
+        send(c, k, std::min(options.burst, per_client - k), latencies[c]);
+    });
+  }
+  for (std::thread& t : threads)
+    t.join();
+  double elapsed = std::chrono::duration<double>(bench_clock::now() - begin).count();
+
+  std::vector<double> all;
+  for (const std::vector<double>& l : latencies)
+    all.insert(all.end(), l.begin(), l.end());
+
+  std::cout << label << ',' << clients << ",throughput," << all.size() / elapsed << ",requests/s\n"
+            << label << ',' << clients << ",latency_p50," << percentile(all, 0.5) << ",us\n"
+            << label << ',' << clients << ",latency_p99," << percentile(all, 0.99) << ",us\n";
+}
+
+static double microseconds_since (bench_clock::time_point begin) {
+  return std::chrono::duration<double, std::micro>(bench_clock::now() - begin).count();
+}
+
+int main(int argc, char **argv) {
+  service_options options;
+  if (!parse_options(argc, argv, options)) {
+    std::cerr << "usage: " << argv[0] << " [--size N] [--density D] [--clients list] [--burst N]"
+              << " [--requests N] [--max-batch list] [--max-wait list] [--socket path]" << std::endl;
+    return 1;
+  }
+
+  std::srand(1);
+  concurrent_neural_network net (random_graph_generator(options.size, options.density),
+                                 random_costs_generator(options.size), 3, 2);
+  std::cerr << net.compiled().n_neurons() << " neurons, " << net.compiled().n_edges()
+            << " edges" << std::endl;
+
+  std::cout << "service,clients,metric,value,unit\n";
+
+  for (unsigned clients : options.clients) {
+    // BASELINE ---------------------------------------------------------------
+
+    std::vector<evaluation_context> contexts (clients, net.create_context());
+    run_clients(options, clients, "direct", [&](unsigned c, unsigned first, unsigned count,
+                                                std::vector<double>& latencies) {
+      std::vector<std::vector<double>> outputs;
+      for (unsigned k = first; k < first + count; k++) {
+        auto begin = bench_clock::now();
+        net(contexts[c], std::vector<std::vector<double>> {client_inputs(c, k)}, outputs);
+        latencies.push_back(microseconds_since(begin));
+      }
+    });
+
+    // SERVICE ----------------------------------------------------------------
+
+    for (unsigned max_batch : options.max_batch) {
+      for (unsigned max_wait : options.max_wait) {
+        inference_service service (net, max_batch, std::chrono::microseconds(max_wait));
+        std::stringstream label;
+        label << "batch " << max_batch << " wait " << max_wait << "us";
+
+        if (options.socket.empty()) {
+          run_clients(options, clients, label.str(), [&](unsigned c, unsigned first, unsigned count,
+                                                         std::vector<double>& latencies) {
+            auto begin = bench_clock::now();
+            std::vector<std::future<std::vector<double>>> results;
+            for (unsigned k = first; k < first + count; k++)
+              results.push_back(service.submit(client_inputs(c, k)));
+            for (std::future<std::vector<double>>& result : results) {
+              result.get();
+              latencies.push_back(microseconds_since(begin));
+            }
+          });
+        } else {
+          if (!service.listen(options.socket)) {
+            std::cerr << "can not listen on " << options.socket << std::endl;
+            return 1;
+          }
+          std::vector<inference_client> connections (clients);
+          for (inference_client& connection : connections) {
+            if (!connection.connect(options.socket)) {
+              std::cerr << "can not connect to " << options.socket << std::endl;
+              return 1;
+            }
+          }
+          label << " socket";
+          run_clients(options, clients, label.str(), [&](unsigned c, unsigned first, unsigned count,
+                                                         std::vector<double>& latencies) {
+            std::vector<double> outputs;
+            for (unsigned k = first; k < first + count; k++) {
+              auto begin = bench_clock::now();
+              connections[c].evaluate(client_inputs(c, k), outputs);
+              latencies.push_back(microseconds_since(begin));
+            }
+          });
+        }
+
+        inference_stats stats = service.get_stats();
+        std::cout << label.str() << ',' << clients << ",mean_batch," << stats.mean_batch() << ",requests\n";
+      }
+    }
+  }
+  return 0;
+}
@@ -0,0 +1,146 @@
+/*
+ * <one line to give the program's name and a brief idea of what it does.>
+ * Copyright (C) 2018  Daniel Darias Sánchez <dariasteam94@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <cstdio>
+#include <cstdlib>
+
+#include "concurrent_neural_network.h"
+#include "random_nets.h"
+#include "test_util.h"
+
+// Construction from sparse edge lists against the dense matrices they
+// describe, directly and through the sparse files
+
+namespace {
+
+typedef std::vector<std::vector<bool>> graph_matrix;
+typedef std::vector<std::vector<double>> cost_matrix;
+
+const unsigned n_inputs = 3;
+const unsigned n_outputs = 2;
+
+// same compiled net and same outputs, bit for bit, over a few steps
+bool same_net(concurrent_neural_network& a, concurrent_neural_network& b) {
+  const compiled_network& x = a.compiled();
+  const compiled_network& y = b.compiled();
+  if (x.n_neurons() != y.n_neurons() || x.n_edges() != y.n_edges())
+    return false;
+  for (unsigned i = 0; i < x.n_neurons(); i++)
+    if (x.original_neurons()[i] != y.original_neurons()[i])
+      return false;
+
+  std::vector<std::vector<double>> batch (5, std::vector<double>(n_inputs, -0.2)), batch_a, batch_b;
+  for (unsigned t = 0; t < 8; t++) {
+    std::vector<double> inputs {0.1 * t, 0.5, -0.3}, outputs_a, outputs_b;
+    a(inputs, outputs_a);
+    b(inputs, outputs_b);
+    a(batch, batch_a);
+    b(batch, batch_b);
+    if (outputs_a != outputs_b || batch_a != batch_b)
+      return false;
+  }
+  return true;
+}
+
+// the connections of the matrices, in the order of the cells
+std::vector<network_edge> matrix_edges(const graph_matrix& graph, const cost_matrix& costs) {
+  std::vector<network_edge> edges;
+  for (unsigned i = 0; i < graph.size(); i++)
+    for (unsigned j = 0; j < graph.size(); j++)
+      if (graph[i][j])
+        edges.push_back(network_edge {i, j, costs[i][j]});
+  return edges;
+}
+
+std::vector<double> matrix_thresholds(const cost_matrix& costs) {
+  std::vector<double> thresholds (costs.size());
+  for (unsigned i = 0; i < costs.size(); i++)
+    thresholds[i] = costs[i][i];
+  return thresholds;
+}
+
+// shuffled connections, repeated with other weights before the right ones,
+// and a self connection and one out of range, which are ignored
+void check_sparse_equivalence() {
+  for (unsigned seed = 1; seed < 6; seed++) {
+    std::srand(seed);
+    unsigned size = 100 + seed * 50;
+    graph_matrix graph = random_graph_generator(size, 0.02 * seed, 0.4);
+    cost_matrix costs = random_costs_generator(size);
+    std::vector<network_edge> edges = matrix_edges(graph, costs);
+
+    std::vector<network_edge> shuffled;
+    for (network_edge edge : edges) {
+      edge.weight += 7;
+      shuffled.push_back(edge);
+    }
+    for (unsigned k = 0; k < shuffled.size(); k++)
+      std::swap(shuffled[k], shuffled[k + std::rand() % (shuffled.size() - k)]);
+    shuffled.insert(shuffled.end(), edges.begin(), edges.end());
+    shuffled.push_back(network_edge {4, 4, 5.0});
+    shuffled.push_back(network_edge {unsigned(graph.size()) + 5, 1, 1.0});
+
+    concurrent_neural_network dense (graph, costs, n_inputs, n_outputs);
+    concurrent_neural_network sparse (shuffled, matrix_thresholds(costs), n_inputs, n_outputs);
+    CHECK(same_net(dense, sparse));
+  }
+}
+
+// both sparse formats give back the net, and a connection out of range
+// makes the file invalid
+void check_sparse_files() {
+  const char* text = "test_construction.txt";
+  const char* binary = "test_construction.bin";
+
+  std::srand(11);
+  graph_matrix graph = random_graph_generator(200, 0.05, 0.4);
+  cost_matrix costs = random_costs_generator(200);
+  std::vector<network_edge> edges = matrix_edges(graph, costs);
+  std::vector<double> thresholds = matrix_thresholds(costs);
+
+  std::vector<double> read_thresholds;
+  std::vector<network_edge> read_edges;
+  for (bool is_binary : {false, true}) {
+    const char* filename = is_binary ? binary : text;
+    CHECK(write_sparse_net_file(filename, thresholds, edges, is_binary));
+    CHECK(read_sparse_net_from_file(filename, read_thresholds, read_edges));
+    concurrent_neural_network dense (graph, costs, n_inputs, n_outputs);
+    concurrent_neural_network loaded (read_edges, read_thresholds, n_inputs, n_outputs);
+    CHECK(same_net(dense, loaded));
+  }
+
+  std::vector<network_edge> out_of_range = edges;
+  out_of_range.push_back(network_edge {unsigned(thresholds.size()), 0, 1.0});
+  for (bool is_binary : {false, true}) {
+    const char* filename = is_binary ? binary : text;
+    CHECK(write_sparse_net_file(filename, thresholds, out_of_range, is_binary));
+    CHECK(!read_sparse_net_from_file(filename, read_thresholds, read_edges));
+    CHECK(read_thresholds.empty() && read_edges.empty());
+  }
+
+  std::remove(text);
+  std::remove(binary);
+}
+
+}
+
+int main() {
+  check_sparse_equivalence();
+  check_sparse_files();
+  return test_util::report("test_construction");
+}
@@ -0,0 +1,124 @@
+/*
+ * <one line to give the program's name and a brief idea of what it does.>
+ * Copyright (C) 2018  Daniel Darias Sánchez <dariasteam94@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <cstdlib>
+
+#include "concurrent_neural_network.h"
+#include "random_nets.h"
+#include "test_util.h"
+
+// Evaluation contexts: contexts that do not belong to a net are refused, and
+// snapshots and forks continue the same sequence
+
+namespace {
+
+const unsigned n_inputs = 3;
+const unsigned n_outputs = 2;
+
+// every call that takes a context refuses one that does not fit the net
+void check_refused(const concurrent_neural_network& net, evaluation_context& ctx) {
+  std::vector<double> inputs (n_inputs, 0.5), outputs;
+  std::vector<std::vector<double>> batch (4, inputs), batch_outputs;
+  std::vector<std::vector<std::vector<double>>> sequences (2, batch), sequences_outputs;
+  std::vector<bool> requested (n_outputs, true);
+
+  CHECK(!net(ctx, inputs, outputs));
+  CHECK(!net(ctx, batch, batch_outputs));
+  CHECK(!net(ctx, requested, inputs, outputs));
+  CHECK(!net.run_sequence(ctx, batch, batch_outputs));
+  CHECK(!net.run_sequences(ctx, sequences, sequences_outputs));
+  CHECK(net.snapshot(ctx).empty());
+}
+
+void check_foreign_contexts() {
+  auto graph = random_graph_generator(100, 0.1, 0.3);
+  auto costs = random_costs_generator(100);
+  concurrent_neural_network net (graph, costs, n_inputs, n_outputs);
+  concurrent_neural_network other (random_graph_generator(40, 0.2, 0.3), random_costs_generator(40),
+                                   n_inputs, n_outputs);
+  CHECK(other.compiled().n_neurons() != net.compiled().n_neurons());
+
+  evaluation_context empty;
+  check_refused(net, empty);
+  evaluation_context foreign = other.create_context();
+  check_refused(net, foreign);
+
+  // the right context is still accepted
+  evaluation_context own = net.create_context();
+  std::vector<double> inputs (n_inputs, 0.5), outputs;
+  CHECK(net(own, inputs, outputs));
+
+  // nor after the net is compiled again with another size
+  unsigned size = net.compiled().n_neurons();
+  for (unsigned i = n_inputs; i < graph.size() - n_outputs && net.compiled().n_neurons() == size; i++)
+    net.remove_neuron(i);
+  CHECK(net.compiled().n_neurons() != size);
+  check_refused(net, own);
+}
+
+// a branch forked from a snapshot follows the same sequence as the net
+// it was taken from, and restoring the snapshot brings the net back
+void check_snapshots() {
+  for (unsigned trial = 0; trial < 20; trial++) {
+    auto graph = random_graph_generator(80, 0.1, 0.4);
+    auto costs = random_costs_generator(80);
+    concurrent_neural_network net (graph, costs, n_inputs, n_outputs);
+    std::vector<double> inputs (n_inputs), outputs;
+    for (unsigned t = 0; t < 5; t++) {
+      inputs.assign(n_inputs, 0.1 * t);
+      net(inputs, outputs);
+    }
+
+    std::vector<double> state = net.snapshot();
+    evaluation_context branch;
+    CHECK(net.fork(state, branch));
+
+    std::vector<std::vector<double>> expected, forked;
+    for (unsigned t = 0; t < 5; t++) {
+      inputs.assign(n_inputs, -0.2 * t);
+      net(inputs, outputs);
+      expected.push_back(outputs);
+      CHECK(net(branch, inputs, outputs));
+      forked.push_back(outputs);
+    }
+    CHECK(forked == expected);
+
+    CHECK(net.restore(state));
+    for (unsigned t = 0; t < 5; t++) {
+      inputs.assign(n_inputs, -0.2 * t);
+      net(inputs, outputs);
+      CHECK(outputs == expected[t]);
+    }
+
+    // a snapshot of another size is refused and leaves the context as it is
+    std::vector<double> wrong (state.size() + 1, 0);
+    evaluation_context untouched;
+    CHECK(!net.fork(wrong, untouched));
+    CHECK(!net(untouched, inputs, outputs));
+    CHECK(!net.restore(wrong));
+  }
+}
+
+}
+
+int main() {
+  std::srand(1);
+  check_foreign_contexts();
+  check_snapshots();
+  return test_util::report("test_contexts");
+}
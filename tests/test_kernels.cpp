@@ -0,0 +1,124 @@
+/*
+ * <one line to give the program's name and a brief idea of what it does.>
+ * Copyright (C) 2018  Daniel Darias Sánchez <dariasteam94@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <cstdlib>
+
+#include "concurrent_neural_network.h"
+#include "kernels.h"
+#include "random_nets.h"
+#include "test_util.h"
+
+// Every kernel set and the fast tanh against the scalar path
+
+namespace {
+
+const double tolerance = 1e-12;
+// bound of the fast tanh, see #tanh_mode
+const double fast_tolerance = 3e-7;
+
+std::vector<double> random_values(unsigned n, double range) {
+  std::vector<double> values (n);
+  for (double& value : values)
+    value = (std::rand() / double(RAND_MAX) * 2 - 1) * range;
+  return values;
+}
+
+void check_kernels(const kernel_set& scalar, const kernel_set& simd) {
+  for (unsigned n = 1; n < 70; n++) {
+    std::vector<double> x = random_values(n, 4);
+    std::vector<double> w = random_values(n, 2);
+    std::vector<double> acc = random_values(n, 4);
+    double weight = random_values(1, 2)[0];
+
+    std::vector<double> a = acc, b = acc;
+    scalar.accumulate(a.data(), x.data(), weight, n);
+    simd.accumulate(b.data(), x.data(), weight, n);
+    CHECK(test_util::close(a, b, tolerance));
+
+    scalar.add(a.data(), x.data(), n);
+    simd.add(b.data(), x.data(), n);
+    CHECK(test_util::close(a, b, tolerance));
+
+    scalar.add_constant(a.data(), weight, n);
+    simd.add_constant(b.data(), weight, n);
+    CHECK(test_util::close(a, b, tolerance));
+
+    scalar.multiply_accumulate(a.data(), x.data(), w.data(), n);
+    simd.multiply_accumulate(b.data(), x.data(), w.data(), n);
+    CHECK(test_util::close(a, b, tolerance));
+
+    for (tanh_mode mode : {tanh_mode::exact, tanh_mode::fast}) {
+      std::vector<double> c = a, d = a;
+      scalar.activate(c.data(), n, 3, 0.25, mode);
+      simd.activate(d.data(), n, 3, 0.25, mode);
+      CHECK(test_util::close(c, d, tolerance));
+
+      c = a;
+      d = a;
+      scalar.activate_lanes(c.data(), n, 2, w.data(), mode);
+      simd.activate_lanes(d.data(), n, 2, w.data(), mode);
+      CHECK(test_util::close(c, d, tolerance));
+    }
+  }
+}
+
+void check_fast_tanh() {
+  for (double x : random_values(100000, 20))
+    CHECK(std::abs(fast_tanh(x) - std::tanh(x)) < fast_tolerance);
+  CHECK(std::abs(fast_tanh(1e300) - 1) < fast_tolerance);
+  CHECK(std::abs(fast_tanh(-1e300) + 1) < fast_tolerance);
+}
+
+// batches evaluated with each kernel set against one sample at a time
+void check_batches(const kernel_set& simd) {
+  auto graph = random_graph_generator(150, 0.2, 0.3);
+  auto costs = random_costs_generator(150);
+
+  for (tanh_mode mode : {tanh_mode::exact, tanh_mode::fast}) {
+    concurrent_neural_network batched (graph, costs, 4, 3);
+    batched.set_kernels(simd);
+    batched.set_tanh_mode(mode);
+
+    std::vector<std::vector<double>> inputs, outputs;
+    for (unsigned b = 0; b < 37; b++)
+      inputs.push_back(random_values(4, 1));
+    CHECK(batched(inputs, outputs));
+    CHECK(outputs.size() == inputs.size());
+
+    for (unsigned b = 0; b < inputs.size() && b < outputs.size(); b++) {
+      concurrent_neural_network single (graph, costs, 4, 3);
+      single.set_tanh_mode(mode);
+      std::vector<double> expected;
+      single(inputs[b], expected);
+      CHECK(test_util::close(outputs[b], expected, tolerance));
+    }
+  }
+}
+
+}
+
+int main() {
+  std::srand(1);
+  std::vector<const kernel_set*> sets = available_kernels();
+  for (const kernel_set* simd : sets) {
+    check_kernels(*sets.front(), *simd);
+    check_batches(*simd);
+  }
+  check_fast_tanh();
+  return test_util::report("test_kernels");
+}
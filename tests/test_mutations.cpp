@@ -0,0 +1,244 @@
+/*
+ * <one line to give the program's name and a brief idea of what it does.>
+ * Copyright (C) 2018  Daniel Darias Sánchez <dariasteam94@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <cstdlib>
+
+#include "concurrent_neural_network.h"
+#include "random_nets.h"
+#include "test_util.h"
+
+// Mutations of a built net against the same net built from the mutated
+// matrices
+
+namespace {
+
+typedef std::vector<std::vector<bool>> graph_matrix;
+typedef std::vector<std::vector<double>> cost_matrix;
+
+const unsigned n_inputs = 3;
+const unsigned n_outputs = 2;
+
+std::vector<double> sample(unsigned t) {
+  return {0.1 * t, 0.5, -0.3};
+}
+
+// a weight changed in place must reach the incremental mode, which only
+// recalculates what changed since the last evaluation
+void check_incremental_weights() {
+  for (unsigned trial = 0; trial < 50; trial++) {
+    // without feedback nothing is dirty after the first evaluation
+    graph_matrix graph = random_graph_generator(80, 0.08, 0);
+    cost_matrix costs = random_costs_generator(80);
+    concurrent_neural_network net (graph, costs, n_inputs, n_outputs);
+    net.set_execution_mode(execution_mode::incremental);
+
+    std::vector<double> outputs;
+    for (unsigned t = 0; t < 3; t++)
+      net(sample(0), outputs);
+
+    // a connection between two alive neurons
+    const unsigned* ids = net.compiled().original_neurons();
+    const unsigned* offsets = net.compiled().predecessor_offsets();
+    unsigned last = net.compiled().n_neurons() - 1;
+    if (offsets[last] == offsets[last + 1])
+      continue;
+    unsigned from = ids[net.compiled().predecessors()[offsets[last]]];
+    unsigned to = ids[last];
+    CHECK(net.set_weight(from, to, costs[from][to] + 1));
+    CHECK(net.set_weight(to, to, costs[to][to] - 1));
+
+    // same state and inputs, every neuron calculated
+    evaluation_context full (net.default_context());
+    std::vector<double> expected;
+    net.set_execution_mode(execution_mode::steps);
+    net(full, sample(0), expected);
+    net.set_execution_mode(execution_mode::incremental);
+    net(sample(0), outputs);
+    CHECK(outputs == expected);
+  }
+}
+
+std::vector<double> run(concurrent_neural_network& net) {
+  evaluation_context context (net.compiled());
+  std::vector<double> outputs, all;
+  for (unsigned t = 0; t < 4; t++) {
+    net(context, sample(t), outputs);
+    all.insert(all.end(), outputs.begin(), outputs.end());
+  }
+  return all;
+}
+
+// the matrices of a net with a neuron inserted at p or removed from it
+void insert_neuron(graph_matrix& graph, cost_matrix& costs, unsigned p) {
+  unsigned size = graph.size() + 1;
+  for (unsigned i = 0; i < graph.size(); i++) {
+    graph[i].insert(graph[i].begin() + p, false);
+    costs[i].insert(costs[i].begin() + p, 0.0);
+  }
+  graph.insert(graph.begin() + p, std::vector<bool>(size, false));
+  costs.insert(costs.begin() + p, std::vector<double>(size, 0.0));
+}
+
+void erase_neuron(graph_matrix& graph, cost_matrix& costs, unsigned p) {
+  for (unsigned i = 0; i < graph.size(); i++) {
+    graph[i].erase(graph[i].begin() + p);
+    costs[i].erase(costs[i].begin() + p);
+  }
+  graph.erase(graph.begin() + p);
+  costs.erase(costs.begin() + p);
+}
+
+// a random connection of the matrices, if one is found
+bool pick_connection(const graph_matrix& graph, unsigned& from, unsigned& to) {
+  for (unsigned attempt = 0; attempt < 100; attempt++) {
+    from = std::rand() % graph.size();
+    to = std::rand() % graph.size();
+    if (from != to && graph[from][to])
+      return true;
+  }
+  return false;
+}
+
+// every mutation, applied to the net and to its matrices, leaves a net that
+// calculates the same as the one built again from the matrices
+void check_rebuild() {
+  for (unsigned seed = 1; seed < 5; seed++) {
+    std::srand(seed);
+    unsigned size = 60 + seed * 20;
+    graph_matrix graph = random_graph_generator(size, 0.02 * seed, 0.4);
+    cost_matrix costs = random_costs_generator(size);
+    bool reorder = (seed % 2 == 0);
+    concurrent_neural_network net (graph, costs, n_inputs, n_outputs);
+    if (reorder)
+      net.reorder_neurons();
+    if (seed == 3)
+      net.set_execution_mode(execution_mode::incremental);
+
+    for (unsigned m = 0; m < 150; m++) {
+      unsigned n = graph.size();
+      unsigned from = std::rand() % n;
+      unsigned to = std::rand() % n;
+      double weight = (std::rand() % 2000) / 1000.0 - 1;
+      bool expected = false;
+      bool done = false;
+
+      switch (std::rand() % 5) {
+        case 0:
+          pick_connection(graph, from, to);
+          expected = (from == to) || graph[from][to];
+          done = net.set_weight(from, to, weight);
+          if (expected)
+            costs[from][to] = weight;
+          break;
+        case 1:
+          expected = (from != to) && !graph[from][to];
+          done = net.add_edge(from, to, weight);
+          if (expected) {
+            graph[from][to] = true;
+            costs[from][to] = weight;
+          }
+          break;
+        case 2:
+          expected = pick_connection(graph, from, to);
+          done = net.remove_edge(from, to);
+          if (expected) {
+            graph[from][to] = false;
+            costs[from][to] = 0;
+          }
+          break;
+        case 3: {
+          pick_connection(graph, from, to);
+          unsigned neuron = 0;
+          done = expected = net.split_edge(from, to, neuron);
+          if (done) {
+            double split = costs[from][to];
+            graph[from][to] = false;
+            costs[from][to] = 0;
+            insert_neuron(graph, costs, neuron);
+            from += (from >= neuron) ? 1 : 0;
+            to += (to >= neuron) ? 1 : 0;
+            graph[from][neuron] = true;
+            costs[from][neuron] = 1;
+            graph[neuron][to] = true;
+            costs[neuron][to] = split;
+          }
+          break;
+        }
+        default:
+          expected = from >= n_inputs && from < n - n_outputs;
+          done = net.remove_neuron(from);
+          if (expected)
+            erase_neuron(graph, costs, from);
+          break;
+      }
+      CHECK(done == expected);
+
+      concurrent_neural_network rebuilt (graph, costs, n_inputs, n_outputs);
+      if (reorder)
+        rebuilt.reorder_neurons();
+      CHECK(net.compiled().n_neurons() == rebuilt.compiled().n_neurons());
+      CHECK(net.compiled().n_edges() == rebuilt.compiled().n_edges());
+      CHECK(net.c_steps() == rebuilt.c_steps());
+      CHECK(run(net) == run(rebuilt));
+    }
+  }
+}
+
+// nets built from a compiled one are mutated with the same indices whether
+// they were reordered before or after
+void check_compiled_indices() {
+  for (unsigned trial = 0; trial < 50; trial++) {
+    graph_matrix graph = random_graph_generator(60, 0.1, 0.3);
+    cost_matrix costs = random_costs_generator(60);
+    concurrent_neural_network built (graph, costs, n_inputs, n_outputs);
+    concurrent_neural_network reordered_image (built);
+    reordered_image.reorder_neurons();
+
+    concurrent_neural_network plain (built.compiled());
+    concurrent_neural_network reordered_after (built.compiled());
+    reordered_after.reorder_neurons();
+    concurrent_neural_network reordered_before (reordered_image.compiled());
+    std::vector<concurrent_neural_network*> nets {&plain, &reordered_after, &reordered_before};
+
+    unsigned size = built.compiled().n_neurons();
+    for (unsigned m = 0; m < 4; m++) {
+      unsigned from = std::rand() % size;
+      unsigned to = std::rand() % size;
+      double weight = (std::rand() % 2000) / 1000.0 - 1;
+      bool expected = (m % 2 == 0) ? plain.set_weight(from, to, weight) : plain.add_edge(from, to, weight);
+      for (unsigned k = 1; k < nets.size(); k++) {
+        bool done = (m % 2 == 0) ? nets[k]->set_weight(from, to, weight) : nets[k]->add_edge(from, to, weight);
+        CHECK(done == expected);
+      }
+    }
+
+    std::vector<double> outputs = run(plain);
+    for (unsigned k = 1; k < nets.size(); k++)
+      CHECK(run(*nets[k]) == outputs);
+  }
+}
+
+}
+
+int main() {
+  check_rebuild();
+  std::srand(1);
+  check_incremental_weights();
+  check_compiled_indices();
+  return test_util::report("test_mutations");
+}
@@ -0,0 +1,142 @@
+/*
+ * <one line to give the program's name and a brief idea of what it does.>
+ * Copyright (C) 2018  Daniel Darias Sánchez <dariasteam94@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+
+#include "compiled_network.h"
+#include "net_io.h"
+#include "random_nets.h"
+#include "test_util.h"
+
+// Binary images: a saved net loads back, and images whose sections do not
+// describe a walkable net are refused even without the checksum
+
+namespace {
+
+const char* filename = "test_net_io.bin";
+
+std::vector<char> read_file() {
+  std::ifstream file (filename, std::ios::binary);
+  return std::vector<char>(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+}
+
+void write_file(const std::vector<char>& bytes) {
+  std::ofstream file (filename, std::ios::binary | std::ios::trunc);
+  file.write(bytes.data(), bytes.size());
+}
+
+uint32_t* section(std::vector<char>& bytes, network_section s) {
+  const network_file_header& header = *reinterpret_cast<const network_file_header*>(bytes.data());
+  return reinterpret_cast<uint32_t*>(bytes.data() + header.sections[s]);
+}
+
+// writes the image with one word changed and checks that it is refused
+void check_corrupted(const std::vector<char>& image, network_section s, unsigned k, uint32_t value) {
+  std::vector<char> bytes = image;
+  section(bytes, s)[k] = value;
+  write_file(bytes);
+
+  compiled_network loaded;
+  CHECK(!compiled_network::load(filename, loaded, false));
+  CHECK(!compiled_network::load(filename, loaded, true));
+}
+
+network_file_header& header(std::vector<char>& bytes) {
+  return *reinterpret_cast<network_file_header*>(bytes.data());
+}
+
+// writes the image with the header changed and its checksum updated, so
+// only the checks of the header can refuse it
+template <class change>
+void check_corrupted_header(const std::vector<char>& image, change f) {
+  std::vector<char> bytes = image;
+  f(header(bytes));
+  header(bytes).checksum = network_checksum(bytes.data(), bytes.size());
+  write_file(bytes);
+
+  compiled_network loaded;
+  CHECK(!compiled_network::load(filename, loaded, false));
+  CHECK(!compiled_network::load(filename, loaded, true));
+}
+
+void check_images() {
+  compiled_network net (random_graph_generator(60, 0.15, 0.3), random_costs_generator(60), 3, 2);
+  CHECK(net.save(filename));
+
+  compiled_network loaded;
+  CHECK(compiled_network::load(filename, loaded, false));
+  CHECK(loaded.n_neurons() == net.n_neurons());
+  CHECK(loaded.n_forward_edges() == net.n_forward_edges());
+
+  std::vector<char> image = read_file();
+  unsigned size = net.n_neurons();
+  CHECK(net.n_forward_edges() > 0 && net.n_feedback_edges() > 0);
+
+  // first neuron with forward predecessors, first with sucessors and first
+  // with feedback predecessors
+  const unsigned* offsets = net.predecessor_offsets();
+  const unsigned* feedback_offsets = net.feedback_predecessor_offsets();
+  unsigned j = 0, i = 0, f = 0;
+  while (offsets[j] == offsets[j + 1])
+    j++;
+  while (net.sucessor_offsets()[i] == net.sucessor_offsets()[i + 1])
+    i++;
+  while (feedback_offsets[f] == feedback_offsets[f + 1])
+    f++;
+
+  check_corrupted(image, ROW_OFFSETS, size, net.n_forward_edges() + 1);
+  check_corrupted(image, ROW_OFFSETS, j + 1, offsets[j + 1] + net.n_forward_edges());
+  check_corrupted(image, SOURCES, offsets[j], j);
+  check_corrupted(image, SOURCES, offsets[j], size);
+  check_corrupted(image, OUT_OFFSETS, 0, 1);
+  check_corrupted(image, TARGETS, net.sucessor_offsets()[i], i);
+  check_corrupted(image, TARGETS, net.sucessor_offsets()[i], size);
+  // inside the net and in order, but not the transpose of the predecessors
+  unsigned target = net.sucessors()[net.sucessor_offsets()[i]];
+  check_corrupted(image, TARGETS, net.sucessor_offsets()[i], target == size - 1 ? size - 2 : size - 1);
+  check_corrupted(image, FEEDBACK_OFFSETS, size, net.n_feedback_edges() - 1);
+  check_corrupted(image, FEEDBACK_SOURCES, feedback_offsets[f], size);
+  if (f > 0)
+    check_corrupted(image, FEEDBACK_SOURCES, feedback_offsets[f], f - 1);
+  check_corrupted(image, FEEDBACK_ORIGINS, 0, size);
+
+  // sums that wrap around
+  check_corrupted_header(image, [](network_file_header& h) { h.inputs = 0xFFFFFFFF; h.outputs = 2; });
+  check_corrupted_header(image, [](network_file_header& h) { h.sections[WEIGHTS] = ~uint64_t(0) - 63; });
+
+  // the checksum covers the header
+  std::vector<char> bytes = image;
+  header(bytes).inputs--;
+  write_file(bytes);
+  CHECK(compiled_network::load(filename, loaded, false));
+  CHECK(!compiled_network::load(filename, loaded, true));
+
+  std::remove(filename);
+}
+
+}
+
+int main() {
+  std::srand(1);
+  check_images();
+  return test_util::report("test_net_io");
+}
@@ -0,0 +1,114 @@
+/*
+ * <one line to give the program's name and a brief idea of what it does.>
+ * Copyright (C) 2018  Daniel Darias Sánchez <dariasteam94@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+
+#include "concurrent_neural_network.h"
+#include "random_nets.h"
+#include "test_util.h"
+
+// Locality reordering: a reordered net calculates exactly the same values as
+// the net in input order, in every execution mode, and keeps its numbering
+// through save and load
+
+namespace {
+
+const unsigned n_inputs = 3;
+const unsigned n_outputs = 2;
+
+void check_same_outputs(execution_mode mode) {
+  for (unsigned seed = 1; seed < 4; seed++) {
+    std::srand(seed);
+    auto graph = random_graph_generator(300, 0.02 * seed, 0.3);
+    auto costs = random_costs_generator(300);
+    concurrent_neural_network plain (graph, costs, n_inputs, n_outputs);
+    concurrent_neural_network reordered (graph, costs, n_inputs, n_outputs);
+    reordered.reorder_neurons();
+    plain.set_execution_mode(mode);
+    reordered.set_execution_mode(mode);
+
+    std::vector<std::vector<double>> batch, batch_plain, batch_reordered;
+    for (unsigned s = 0; s < 6; s++)
+      batch.push_back({0.1 * s, -0.2, 0.3});
+    for (unsigned t = 0; t < 6; t++) {
+      std::vector<double> inputs {0.1 * t, 0.4, -0.6}, outputs_plain, outputs_reordered;
+      CHECK(plain(inputs, outputs_plain));
+      CHECK(reordered(inputs, outputs_reordered));
+      CHECK(outputs_plain == outputs_reordered);
+      CHECK(plain(batch, batch_plain));
+      CHECK(reordered(batch, batch_reordered));
+      CHECK(batch_plain == batch_reordered);
+    }
+
+    std::vector<std::vector<std::vector<double>>> sequences (4, batch), sequences_plain, sequences_reordered;
+    CHECK(plain.run_sequences(sequences, sequences_plain));
+    CHECK(reordered.run_sequences(sequences, sequences_reordered));
+    CHECK(sequences_plain == sequences_reordered);
+  }
+}
+
+// only the hidden neurons move, the original indices are the same set, and
+// the numbering survives save and load
+void check_numbering() {
+  const char* filename = "test_reorder.bin";
+  std::srand(7);
+  auto graph = random_graph_generator(400, 0.03, 0.3);
+  auto costs = random_costs_generator(400);
+  concurrent_neural_network plain (graph, costs, n_inputs, n_outputs);
+  concurrent_neural_network reordered (graph, costs, n_inputs, n_outputs);
+  reordered.reorder_neurons();
+
+  const compiled_network& a = plain.compiled();
+  const compiled_network& b = reordered.compiled();
+  unsigned size = a.n_neurons();
+  CHECK(b.n_neurons() == size);
+  std::vector<unsigned> ids_a (a.original_neurons(), a.original_neurons() + size);
+  std::vector<unsigned> ids_b (b.original_neurons(), b.original_neurons() + size);
+  CHECK(ids_a != ids_b);
+  for (unsigned i = 0; i < size; i++)
+    if (i < n_inputs || i >= size - n_outputs)
+      CHECK(ids_a[i] == ids_b[i]);
+  std::sort(ids_b.begin(), ids_b.end());
+  CHECK(ids_a == ids_b);
+
+  CHECK(reordered.save(filename));
+  compiled_network loaded;
+  CHECK(compiled_network::load(filename, loaded));
+  CHECK(loaded.n_neurons() == size);
+  CHECK(std::equal(b.original_neurons(), b.original_neurons() + size, loaded.original_neurons()));
+  std::remove(filename);
+
+  // an order that turns forward connections into feedback is refused
+  std::vector<unsigned> reverse (size);
+  for (unsigned i = 0; i < size; i++)
+    reverse[i] = size - 1 - i;
+  compiled_network refused;
+  CHECK(!a.permuted(reverse, refused));
+}
+
+}
+
+int main() {
+  check_same_outputs(execution_mode::steps);
+  check_same_outputs(execution_mode::dataflow);
+  check_same_outputs(execution_mode::incremental);
+  check_numbering();
+  return test_util::report("test_reorder");
+}
@@ -0,0 +1,60 @@
+/*
+ * <one line to give the program's name and a brief idea of what it does.>
+ * Copyright (C) 2018  Daniel Darias Sánchez <dariasteam94@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef TEST_UTIL_H
+#define TEST_UTIL_H
+
+#include <cmath>
+#include <iostream>
+#include <vector>
+
+/**
+ * @brief Minimal checks for the programs of make test. Every failed check
+ * is printed and counted, and the program returns the number of failures.
+ */
+namespace test_util {
+  inline unsigned& failures () {
+    static unsigned count = 0;
+    return count;
+  }
+
+  inline void check (bool condition, const char* what, const char* file, int line) {
+    if (!condition) {
+      std::cerr << file << ":" << line << ": failed: " << what << std::endl;
+      failures()++;
+    }
+  }
+
+  inline bool close (const std::vector<double>& a, const std::vector<double>& b, double tolerance) {
+    if (a.size() != b.size())
+      return false;
+    for (unsigned i = 0; i < a.size(); i++)
+      if (!(std::abs(a[i] - b[i]) <= tolerance))
+        return false;
+    return true;
+  }
+
+  inline int report (const char* name) {
+    std::cout << name << ": " << (failures() == 0 ? "ok" : "FAILED") << std::endl;
+    return failures() == 0 ? 0 : 1;
+  }
+}
+
+#define CHECK(condition) test_util::check((condition), #condition, __FILE__, __LINE__)
+
+#endif // TEST_UTIL_H
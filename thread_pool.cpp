@@ -0,0 +1,136 @@
+/*
+ * <one line to give the program's name and a brief idea of what it does.>
+ * Copyright (C) 2018  Daniel Darias Sánchez <dariasteam94@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <algorithm>
+
+#include "numa_placement.h"
+#include "thread_pool.h"
+
+thread_pool::thread_pool(unsigned int n_threads) : stopping(false) {
+  workers.reserve(n_threads);
+  for (unsigned i = 0; i < n_threads; i++)
+    workers.emplace_back(&thread_pool::work, this);
+}
+
+thread_pool::thread_pool(unsigned int n_threads, const std::vector<unsigned>& cpus) : stopping(false) {
+  workers.reserve(n_threads);
+  for (unsigned i = 0; i < n_threads; i++) {
+    std::vector<unsigned> cpu;
+    if (!cpus.empty())
+      cpu.push_back(cpus[i % cpus.size()]);
+    workers.emplace_back([this, cpu] {
+      pin_current_thread(cpu);
+      work();
+    });
+  }
+}
+
+thread_pool::~thread_pool() {
+  {
+    std::lock_guard<std::mutex> lock (mutex);
+    stopping = true;
+  }
+  pending.notify_all();
+  for (auto& worker : workers)
+    worker.join();
+}
+
+thread_pool& thread_pool::shared() {
+  static unsigned hardware = std::thread::hardware_concurrency();
+  static thread_pool pool (hardware > 1 ? hardware - 1 : 0);
+  return pool;
+}
+
+void thread_pool::work() {
+  while (true) {
+    task t;
+    {
+      std::unique_lock<std::mutex> lock (mutex);
+      pending.wait(lock, [&] { return stopping || !tasks.empty(); });
+      if (tasks.empty())
+        return;
+      t = tasks.front();
+      tasks.pop_front();
+    }
+    execute(t);
+  }
+}
+
+void thread_pool::execute(const task& t) {
+  (*t.owner->body)(t.begin, t.end);
+  if (t.owner->remaining.fetch_sub(1) == 1) {
+    std::lock_guard<std::mutex> lock (mutex);
+    finished.notify_all();
+  }
+}
+
+bool thread_pool::run_pending() {
+  task t;
+  {
+    std::lock_guard<std::mutex> lock (mutex);
+    if (tasks.empty())
+      return false;
+    t = tasks.front();
+    tasks.pop_front();
+  }
+  execute(t);
+  return true;
+}
+
+void thread_pool::parallel_for(unsigned int begin, unsigned int end,
+                               const std::function<void (unsigned, unsigned)>& body,
+                               unsigned int grain) {
+  if (begin >= end)
+    return;
+
+  unsigned count = end - begin;
+  unsigned chunks = std::min<unsigned>(workers.size() + 1, (count + grain - 1) / grain);
+  if (chunks <= 1) {
+    body(begin, end);
+    return;
+  }
+
+  job j;
+  j.body = &body;
+  j.remaining = chunks;
+
+  // first chunk is calculated by the caller
+  unsigned chunk_size = count / chunks;
+  unsigned extra = count % chunks;
+  unsigned first_end = begin + chunk_size + (extra > 0 ? 1 : 0);
+  {
+    std::lock_guard<std::mutex> lock (mutex);
+    unsigned chunk_begin = first_end;
+    for (unsigned i = 1; i < chunks; i++) {
+      unsigned chunk_end = chunk_begin + chunk_size + (i < extra ? 1 : 0);
+      tasks.push_back(task{&j, chunk_begin, chunk_end});
+      chunk_begin = chunk_end;
+    }
+  }
+  pending.notify_all();
+
+  execute(task{&j, begin, first_end});
+
+  // help with the queue while the rest of the chunks finish
+  while (j.remaining.load() != 0) {
+    if (run_pending())
+      continue;
+    std::unique_lock<std::mutex> lock (mutex);
+    finished.wait(lock, [&] { return j.remaining.load() == 0 || !tasks.empty(); });
+  }
+}
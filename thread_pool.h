@@ -0,0 +1,104 @@
+/*
+ * <one line to give the program's name and a brief idea of what it does.>
+ * Copyright (C) 2018  Daniel Darias Sánchez <dariasteam94@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef THREAD_POOL_H
+#define THREAD_POOL_H
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/**
+ * @brief Long lived set of worker threads that calculates ranges of neurons.
+ * It can be shared by any number of networks, even when they are evaluated
+ * from different threads at the same time.
+ *
+ */
+class thread_pool {
+private:
+  struct job {
+    const std::function<void (unsigned, unsigned)>* body;
+    std::atomic<unsigned> remaining;
+  };
+
+  struct task {
+    job* owner;
+    unsigned begin;
+    unsigned end;
+  };
+
+  std::vector<std::thread> workers;
+  std::deque<task> tasks;
+
+  std::mutex mutex;
+  std::condition_variable pending;
+  std::condition_variable finished;
+  bool stopping;
+
+  void work ();
+  void execute (const task& t);
+
+  /**
+   * @brief Runs one queued task in the calling thread
+   *
+   * @return bool false if the queue was empty
+   */
+  bool run_pending ();
+
+public:
+  /**
+   * @param n_threads p_n_threads: number of workers. The thread that calls
+   * #parallel_for also calculates, so 0 means sequential evaluation.
+   */
+  explicit thread_pool (unsigned n_threads);
+
+  /**
+   * @brief Pool whose worker i is pinned to cpus[i % cpus.size()], see
+   * #pin_current_thread. The workers float if cpus is empty or the affinity
+   * can not be set.
+   */
+  thread_pool (unsigned n_threads, const std::vector<unsigned>& cpus);
+  ~thread_pool ();
+
+  thread_pool (const thread_pool&) = delete;
+  thread_pool& operator= (const thread_pool&) = delete;
+
+  unsigned size () const { return workers.size(); }
+
+  /**
+   * @brief Splits [begin, end) in chunks, calculates them concurrently and
+   * returns once all of them have finished (barrier).
+   *
+   * @param grain p_grain: minimum number of elements of each chunk
+   */
+  void parallel_for (unsigned begin, unsigned end,
+                     const std::function<void (unsigned, unsigned)>& body,
+                     unsigned grain = 1);
+
+  /**
+   * @brief Pool used by the networks that are not given one, with one worker
+   * less than the hardware threads (the caller works too).
+   */
+  static thread_pool& shared ();
+};
+
+#endif // THREAD_POOL_H